@@ -0,0 +1,142 @@
+#ifndef MAZE_BATCH_H
+#define MAZE_BATCH_H
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include "Maze.h"
+#include "GeneratorContext.h"
+#include "Parallel.h"
+#include "io.h"
+#include "generator/Tiled.h"
+#include "solver/Diameter.h"
+
+/**
+ * Many mazes of the same size to generate and write out.
+ */
+typedef struct {
+    int width;
+    int height;
+    enum MazeLayout layout;
+    void (*generator)(const Maze *, GeneratorContext *);
+    int tile_size;
+    size_t count;
+    const char *directory;
+    uint64_t seed;
+    // what to do with the longest path of each maze
+    int diameter_flags;
+    // the next maze a worker should take
+    atomic_size_t next;
+    // set when a maze could not be written
+    atomic_int failed;
+} MazeBatch;
+
+void maze_batch_worker(void *data, size_t start, size_t end);
+
+/**
+ * Generate a number of mazes at the same time without showing them, writing
+ * each to a file named maze-N.maze in a directory.
+ *
+ * Each thread is a worker with it's own maze and context that it reuses for
+ * every maze it generates, taking the number of the next maze to do from a
+ * shared counter. Maze N is generated with a seed taken from random stream N
+ * of the given seed, so the files are the same whatever the thread count.
+ * @param width The width of the mazes
+ * @param height The height of the mazes
+ * @param layout The grid layout each worker's maze uses
+ * @param maze_generator The generator to use
+ * @param tile_size Generate each maze in tiles of this size or 0 for whole
+ * @param count The number of mazes
+ * @param directory The directory to write them to, it must already exist
+ * @param seed The seed the seed of each maze comes from
+ * @param thread_count The number of workers
+ * @param diameter_flags What to do with the longest path of each maze before
+ * it is written, see report_maze_diameter, or 0 to not find it
+ * @return 0 if every maze was written
+ */
+int generate_maze_batch(
+        int width,
+        int height,
+        enum MazeLayout layout,
+        void (*maze_generator)(const Maze *, GeneratorContext *),
+        int tile_size,
+        size_t count,
+        const char *directory,
+        uint64_t seed,
+        int thread_count,
+        int diameter_flags
+) {
+    if (maze_generator == NULL || directory == NULL) {
+        fprintf(stderr, "Invalid arguments for batch generation");
+        return 1;
+    }
+    if (thread_count < 1) thread_count = 1;
+    if ((size_t) thread_count > count) thread_count = count == 0 ? 1 : (int) count;
+
+    MazeBatch batch;
+    batch.width = width;
+    batch.height = height;
+    batch.layout = layout;
+    batch.generator = maze_generator;
+    batch.tile_size = tile_size;
+    batch.count = count;
+    batch.directory = directory;
+    batch.seed = seed;
+    batch.diameter_flags = diameter_flags;
+    atomic_init(&batch.next, 0);
+    atomic_init(&batch.failed, 0);
+
+    // one job per worker, the workers share out the mazes themselves
+    run_parallel(thread_count, (size_t) thread_count, maze_batch_worker, &batch);
+    return atomic_load(&batch.failed);
+}
+
+void maze_batch_worker(void *data, size_t start, size_t end) {
+    MazeBatch *batch = data;
+    GeneratorContext *context = new_generator_context(0);
+    // the workers already use every thread
+    context->thread_count = 1;
+    Maze *maze = new_maze_with_layout(batch->width, batch->height, false, batch->layout);
+    DiameterSolver *solver = batch->diameter_flags != 0 ? new_diameter_solver() : NULL;
+    size_t path_size = strlen(batch->directory) + 32;
+    char *path = malloc(path_size);
+    if (path == NULL) {
+        fprintf(stderr, "Unable to allocate file path");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t job = start; job < end; job++) {
+        for (;;) {
+            size_t number = atomic_fetch_add(&batch->next, 1);
+            if (number >= batch->count) break;
+
+            Random random;
+            seed_random_stream(&random, batch->seed, (uint64_t) number);
+            generate_maze_with_seed_in_tiles(
+                    maze, context, batch->generator, next_random(&random), batch->tile_size
+            );
+
+            snprintf(path, path_size, "%s/maze-%zu.maze", batch->directory, number);
+            if (batch->diameter_flags != 0) {
+                report_maze_diameter(solver, maze, batch->diameter_flags, 1, path);
+            }
+            FILE *file = fopen(path, "wb");
+            if (file == NULL) {
+                fprintf(stderr, "Unable to open %s\n", path);
+                atomic_store(&batch->failed, 1);
+                continue;
+            }
+            if (write_maze(file, maze) != 0 || ferror(file)) {
+                fprintf(stderr, "Failed writing to %s\n", path);
+                atomic_store(&batch->failed, 1);
+            }
+            if (fclose(file) != 0) atomic_store(&batch->failed, 1);
+        }
+    }
+
+    free(path);
+    delete_diameter_solver(solver);
+    delete_maze(maze);
+    delete_generator_context(context);
+}
+
+#endif //MAZE_BATCH_H
@@ -0,0 +1,485 @@
+#ifndef MAZE_GENERATORCONTEXT_H
+#define MAZE_GENERATORCONTEXT_H
+
+#include <stdint.h>
+#include "Maze.h"
+#include "utils.h"
+#include "Random.h"
+#include "Parallel.h"
+
+// directions entry of a cell not yet reached by flood_maze_part
+#define PART_UNSEEN 0xFFu
+
+/**
+ * A rectangle of cells from start up to but not including end
+ */
+typedef struct {
+    int start_x;
+    int start_y;
+    int end_x;
+    int end_y;
+} MazeSegment;
+
+size_t segment_cells(MazeSegment segment) {
+    return (size_t) (segment.end_x - segment.start_x) * (size_t) (segment.end_y - segment.start_y);
+}
+
+/**
+ * Scratch space and random state used by the maze generators.
+ *
+ * The buffers are kept on the heap and only grow, so a context that is used
+ * to generate the same maze over and over only allocates the first time.
+ * Generators only draw random numbers from the context, so a context per
+ * thread lets mazes be generated at the same time.
+ */
+typedef struct {
+    Random random;
+    // the most threads a generator can use
+    int thread_count;
+    // one bit per grid index
+    uint64_t *visited;
+    size_t visited_words;
+    // one bit per maze row
+    uint64_t *row_marks;
+    size_t row_mark_words;
+    // one direction per grid index
+    unsigned char *directions;
+    size_t direction_capacity;
+    // parts of the maze to work on separately
+    MazeSegment *segments;
+    size_t segment_count;
+    size_t segment_capacity;
+    // grid indexes, used as a stack or similar
+    size_t *indexes;
+    size_t index_capacity;
+    // where each grid index is in context->indexes, one per grid index
+    size_t *slots;
+    size_t slot_capacity;
+    // disjoint sets, one parent and rank per grid index
+    size_t *set_parents;
+    size_t set_parent_capacity;
+    unsigned char *set_ranks;
+    size_t set_rank_capacity;
+} GeneratorContext;
+
+/**
+ * Create a new generator context.
+ * @param seed The seed for the random numbers the generators use
+ * @return The new context
+ */
+GeneratorContext *new_generator_context(uint64_t seed) {
+    GeneratorContext *context = malloc(sizeof(GeneratorContext));
+    if (context == NULL) {
+        fprintf(stderr, "Unable to allocate generator context");
+        exit(EXIT_FAILURE);
+    }
+    seed_random(&context->random, seed);
+    context->thread_count = available_threads();
+    context->visited = NULL;
+    context->visited_words = 0;
+    context->row_marks = NULL;
+    context->row_mark_words = 0;
+    context->directions = NULL;
+    context->direction_capacity = 0;
+    context->segments = NULL;
+    context->segment_count = 0;
+    context->segment_capacity = 0;
+    context->indexes = NULL;
+    context->index_capacity = 0;
+    context->slots = NULL;
+    context->slot_capacity = 0;
+    context->set_parents = NULL;
+    context->set_parent_capacity = 0;
+    context->set_ranks = NULL;
+    context->set_rank_capacity = 0;
+    return context;
+}
+
+void delete_generator_context(GeneratorContext *context) {
+    if (context == NULL) return;
+    free(context->visited);
+    free(context->row_marks);
+    free(context->directions);
+    free(context->segments);
+    free(context->indexes);
+    free(context->slots);
+    free(context->set_parents);
+    free(context->set_ranks);
+    free(context);
+}
+
+/**
+ * Grow a buffer to hold at least count entries of the given size.
+ * @param buffer The buffer, can be NULL
+ * @param capacity A pointer to the current capacity of the buffer in entries
+ * @param count The number of entries needed
+ * @param size The size of each entry
+ * @return The buffer, which may have moved
+ */
+void *reserve_generator_buffer(void *buffer, size_t *capacity, size_t count, size_t size) {
+    if (*capacity >= count) return buffer;
+    void *grown = realloc(buffer, checked_size_multiply(count, size));
+    if (grown == NULL) {
+        fprintf(stderr, "Unable to grow generator buffer to %zu entries", count);
+        exit(EXIT_FAILURE);
+    }
+    *capacity = count;
+    return grown;
+}
+
+/**
+ * Clears the visited set ready to generate the given maze.
+ * @param context The generator context
+ * @param maze The maze that will be generated
+ */
+void reset_visited(GeneratorContext *context, const Maze *maze) {
+    size_t words = (maze->grid_size + 63) / 64;
+    context->visited = reserve_generator_buffer(
+            context->visited, &context->visited_words, words, sizeof(uint64_t)
+    );
+    memset(context->visited, 0, words * sizeof(uint64_t));
+}
+
+bool is_visited(const GeneratorContext *context, size_t index) {
+    return (context->visited[index / 64] >> (index % 64)) & 1u;
+}
+
+void set_visited(GeneratorContext *context, size_t index) {
+    context->visited[index / 64] |= (uint64_t) 1 << (index % 64);
+}
+
+/**
+ * @param context The generator context
+ * @param maze The maze
+ * @param index The grid index of a cell
+ * @return The directions from the cell to cells in the maze that have not
+ * been visited, as DIRECTION_BIT flags
+ */
+unsigned int unvisited_directions(const GeneratorContext *context, const Maze *maze, size_t index) {
+    unsigned int possible = get_neighbour_mask(maze, index);
+    for (int dir = 0; dir < DIRECTION_COUNT; dir++) {
+        size_t adjacent = get_index_adjacent(maze, index, dir);
+        possible &= ~((unsigned int) is_visited(context, adjacent) << (unsigned int) dir);
+    }
+    return possible;
+}
+
+/**
+ * @param context The generator context
+ * @param maze The maze
+ * @param index The grid index of a cell
+ * @return The directions from the cell to visited cells, as DIRECTION_BIT
+ * flags, the border is never visited
+ */
+unsigned int visited_directions(const GeneratorContext *context, const Maze *maze, size_t index) {
+    unsigned int visited_dirs = 0;
+    for (int dir = 0; dir < DIRECTION_COUNT; dir++) {
+        size_t adjacent = get_index_adjacent(maze, index, dir);
+        visited_dirs |= (unsigned int) is_visited(context, adjacent) << (unsigned int) dir;
+    }
+    return visited_dirs;
+}
+
+/**
+ * Find a cell to start again from when a generator has visited every cell it
+ * can reach.
+ *
+ * Mazes with cells missing can be split into parts that cannot reach each
+ * other. Generators that grow from visited cells start again from here each
+ * time they run out, so each part gets a maze of it's own.
+ * @param context The generator context
+ * @param maze The maze
+ * @param cursor Where to start looking, 0 at first. It is left on the cell
+ * found so the grid is only looked through once over all the calls.
+ * @return The grid index of the first cell in the maze from cursor on that
+ * has not been visited, there must be one
+ */
+size_t next_unvisited_index(const GeneratorContext *context, const Maze *maze, size_t *cursor) {
+    size_t index = *cursor;
+    while (!index_in_maze(maze, index) || is_visited(context, index)) {
+        index++;
+    }
+    *cursor = index;
+    return index;
+}
+
+/**
+ * Clears the row marks ready to generate the given maze.
+ * @param context The generator context
+ * @param maze The maze that will be generated
+ */
+void reset_row_marks(GeneratorContext *context, const Maze *maze) {
+    size_t words = ((size_t) maze->height + 63) / 64;
+    context->row_marks = reserve_generator_buffer(
+            context->row_marks, &context->row_mark_words, words, sizeof(uint64_t)
+    );
+    memset(context->row_marks, 0, words * sizeof(uint64_t));
+}
+
+void mark_row(GeneratorContext *context, int y) {
+    context->row_marks[y / 64] |= (uint64_t) 1 << (y % 64);
+}
+
+void unmark_row(GeneratorContext *context, int y) {
+    context->row_marks[y / 64] &= ~((uint64_t) 1 << (y % 64));
+}
+
+/**
+ * Find the first marked row at or after a given row, skipping 64 unmarked
+ * rows at a time.
+ * @param context The generator context
+ * @param maze The maze
+ * @param from The row to start looking at
+ * @return The marked row or the maze height if there are none
+ */
+int next_marked_row(const GeneratorContext *context, const Maze *maze, int from) {
+    const int height = maze->height;
+    if (from >= height) return height;
+    const size_t words = ((size_t) height + 63) / 64;
+    size_t word = (size_t) from / 64;
+    uint64_t bits = context->row_marks[word] & (~(uint64_t) 0 << (from % 64));
+    while (bits == 0) {
+        if (++word >= words) return height;
+        bits = context->row_marks[word];
+    }
+    return (int) (word * 64) + count_trailing_zeros(bits);
+}
+
+/**
+ * Makes sure there is a direction entry for every grid index in the maze.
+ * @param context The generator context
+ * @param maze The maze
+ * @return context->directions
+ */
+unsigned char *reserve_directions(GeneratorContext *context, const Maze *maze) {
+    context->directions = reserve_generator_buffer(
+            context->directions, &context->direction_capacity,
+            maze->grid_size, sizeof(unsigned char)
+    );
+    return context->directions;
+}
+
+/**
+ * Add a segment to the end of context->segments, growing it if needed.
+ * @param context The generator context
+ * @param segment The segment to add
+ */
+void push_segment(GeneratorContext *context, MazeSegment segment) {
+    if (context->segment_count == context->segment_capacity) {
+        size_t capacity = context->segment_capacity < 16 ? 16 : checked_size_multiply(context->segment_capacity, 2);
+        context->segments = reserve_generator_buffer(
+                context->segments, &context->segment_capacity, capacity, sizeof(MazeSegment)
+        );
+    }
+    context->segments[context->segment_count++] = segment;
+}
+
+/**
+ * Makes sure there is room for count grid indexes in context->indexes.
+ * @param context The generator context
+ * @param count The number of indexes needed
+ * @return context->indexes
+ */
+size_t *reserve_indexes(GeneratorContext *context, size_t count) {
+    context->indexes = reserve_generator_buffer(
+            context->indexes, &context->index_capacity, count, sizeof(size_t)
+    );
+    return context->indexes;
+}
+
+/**
+ * Makes sure there is a slot for every grid index in the maze and marks them
+ * all as not in context->indexes.
+ * @param context The generator context
+ * @param maze The maze
+ * @return context->slots
+ */
+size_t *reset_slots(GeneratorContext *context, const Maze *maze) {
+    context->slots = reserve_generator_buffer(
+            context->slots, &context->slot_capacity, maze->grid_size, sizeof(size_t)
+    );
+    memset(context->slots, 0xFF, maze->grid_size * sizeof(size_t));
+    return context->slots;
+}
+
+/**
+ * Puts every grid index of the maze into a set of it's own.
+ * @param context The generator context
+ * @param maze The maze
+ */
+void reset_sets(GeneratorContext *context, const Maze *maze) {
+    const size_t grid_size = maze->grid_size;
+    context->set_parents = reserve_generator_buffer(
+            context->set_parents, &context->set_parent_capacity,
+            grid_size, sizeof(size_t)
+    );
+    context->set_ranks = reserve_generator_buffer(
+            context->set_ranks, &context->set_rank_capacity,
+            grid_size, sizeof(unsigned char)
+    );
+    for (size_t i = 0; i < grid_size; i++) {
+        context->set_parents[i] = i;
+    }
+    memset(context->set_ranks, 0, grid_size);
+}
+
+/**
+ * Find the set a grid index is in, flattening the path to it on the way.
+ * @param context The generator context
+ * @param index The grid index
+ * @return The grid index at the root of the set
+ */
+size_t find_set(GeneratorContext *context, size_t index) {
+    size_t *parents = context->set_parents;
+    size_t root = index;
+    while (parents[root] != root) {
+        root = parents[root];
+    }
+    while (parents[index] != root) {
+        size_t next = parents[index];
+        parents[index] = root;
+        index = next;
+    }
+    return root;
+}
+
+/**
+ * Join the sets two grid indexes are in, hanging the shallower one off the
+ * deeper one.
+ * @param context The generator context
+ * @param index1 A grid index
+ * @param index2 Another grid index
+ * @return false if they were already in the same set
+ */
+bool join_sets(GeneratorContext *context, size_t index1, size_t index2) {
+    size_t root1 = find_set(context, index1);
+    size_t root2 = find_set(context, index2);
+    if (root1 == root2) return false;
+    unsigned char *ranks = context->set_ranks;
+    if (ranks[root1] < ranks[root2]) {
+        size_t swap = root1;
+        root1 = root2;
+        root2 = swap;
+    }
+    context->set_parents[root2] = root1;
+    if (ranks[root1] == ranks[root2]) ranks[root1]++;
+    return true;
+}
+
+/**
+ * Join up the trees left by a generator that can split a masked maze.
+ *
+ * Generators that only look at their near neighbours can leave a part of a
+ * masked maze that all connects split into trees that do not reach each
+ * other. Every wall between two of these trees is gone through in a random
+ * order and opened if it's cells are still in different trees, so each part
+ * of the maze ends up as one tree. The maze must not have any loops.
+ * @param maze The maze
+ * @param context The generator context
+ */
+void connect_maze_parts(const Maze *maze, GeneratorContext *context) {
+    const int width = maze->width;
+    const int height = maze->height;
+    reset_sets(context, maze);
+    for (int y = 0; y < height; y++) {
+        size_t index = index_at(maze, 0, y);
+        for (int x = 0; x < width; x++, index = get_index_adjacent(maze, index, EAST)) {
+            unsigned int walls = get_open_walls(maze, index);
+            if (walls & DIRECTION_BIT(EAST)) join_sets(context, index, get_index_adjacent(maze, index, EAST));
+            if (walls & DIRECTION_BIT(SOUTH)) join_sets(context, index, get_index_adjacent(maze, index, SOUTH));
+        }
+    }
+
+    // walls stored the same way as Kruskal's, the grid index of the cell to
+    // the west or north shifted up with the low bit set for a north south wall
+    size_t wall_count = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        size_t *walls = pass == 0 ? NULL : reserve_indexes(context, wall_count);
+        size_t count = 0;
+        for (int y = 0; y < height; y++) {
+            size_t index = index_at(maze, 0, y);
+            for (int x = 0; x < width; x++, index = get_index_adjacent(maze, index, EAST)) {
+                if (!index_in_maze(maze, index)) continue;
+                size_t root = find_set(context, index);
+                for (int dir = EAST; dir <= SOUTH; dir++) {
+                    size_t adjacent = get_index_adjacent(maze, index, dir);
+                    if (!index_in_maze(maze, adjacent) || find_set(context, adjacent) == root) continue;
+                    if (walls != NULL) walls[count] = (index << 1u) | (dir == SOUTH ? 1u : 0u);
+                    count++;
+                }
+            }
+        }
+        wall_count = count;
+    }
+    if (wall_count == 0) return;
+
+    size_t *walls = context->indexes;
+    for (size_t i = 0; i < wall_count; i++) {
+        size_t pick = i + random_below(&context->random, wall_count - i);
+        size_t wall = walls[pick];
+        walls[pick] = walls[i];
+
+        size_t index = wall >> 1u;
+        int dir = (wall & 1u) ? SOUTH : EAST;
+        if (join_sets(context, index, get_index_adjacent(maze, index, dir))) {
+            link_index_in_dir(maze, index, dir);
+        }
+    }
+}
+
+/**
+ * Mark every cell that can be reached from start, linked or not, by setting
+ * it's entry in context->directions to 0.
+ *
+ * Entries for cells not reached yet must be PART_UNSEEN. context->indexes is
+ * used as the stack.
+ * @param maze The maze
+ * @param context The generator context
+ * @param start The grid index to start from
+ * @return The number of cells newly marked
+ */
+size_t flood_maze_part(const Maze *maze, GeneratorContext *context, size_t start) {
+    unsigned char *directions = context->directions;
+    size_t *stack = reserve_indexes(context, maze->cell_count);
+    size_t count = 0;
+    size_t marked = 1;
+    directions[start] = 0;
+    stack[count++] = start;
+    while (count > 0) {
+        size_t index = stack[--count];
+        unsigned int neighbours = get_neighbour_mask(maze, index);
+        while (neighbours != 0) {
+            int dir = count_trailing_zeros(neighbours);
+            neighbours &= neighbours - 1;
+            size_t adjacent = get_index_adjacent(maze, index, dir);
+            if (directions[adjacent] != PART_UNSEEN) continue;
+            directions[adjacent] = 0;
+            stack[count++] = adjacent;
+            marked++;
+        }
+    }
+    return marked;
+}
+
+/**
+ * Generate a maze from a given seed.
+ *
+ * The context is reseeded and the seed is kept in the maze so the same maze
+ * can be generated again from a saved file.
+ * @param maze The maze to generate
+ * @param context The generator context
+ * @param maze_generator The generator to use
+ * @param seed The seed to generate from
+ */
+void generate_maze_with_seed(
+        const Maze *maze,
+        GeneratorContext *context,
+        void (*maze_generator)(const Maze *, GeneratorContext *),
+        uint64_t seed
+) {
+    seed_random(&context->random, seed);
+    ((Maze *) maze)->seed = seed;
+    maze_generator(maze, context);
+}
+
+#endif //MAZE_GENERATORCONTEXT_H
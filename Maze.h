@@ -4,10 +4,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
 #include <string.h>
 
 #define DIRECTION_COUNT 4
 
+// Coordinates are ints and the grid border needs one more on each side
+#define MAX_MAZE_DIMENSION (INT_MAX - 2)
+
 enum Direction {
     NORTH = 0,
     EAST = 1,
@@ -15,6 +21,20 @@ enum Direction {
     WEST = 3
 };
 
+/**
+ * Each cell in the grid is a single byte of flags, the low 4 bits say which
+ * directions are open (indexed by Direction) and MISSING_CELL marks a cell
+ * that is not part of the maze:
+ *
+ * <code><pre>
+ * ---M WSEN<br/>
+ * 0000 0000
+ * </pre></code>
+ */
+#define DIRECTION_BIT(dir) (1u << (unsigned int) (dir))
+#define OPEN_WALLS_MASK 15u
+#define MISSING_CELL 16u
+
 int rotate_clockwise(const int dir) {
     int new_dir = dir + 1;
     if (new_dir > WEST) new_dir = NORTH;
@@ -27,97 +47,512 @@ int rotate_counter_clockwise(const int dir) {
     return new_dir;
 }
 
+int opposite_direction(const int dir) {
+    return (dir + 2) % DIRECTION_COUNT;
+}
+
+/**
+ * How the cells of a Maze are ordered in it's grid.
+ *
+ * LAYOUT_ROW_MAJOR stores each row one after the other.
+ * LAYOUT_TILED stores TILE_SIZE x TILE_SIZE blocks one after the other, so
+ * moving north or south usually stays inside the same block.
+ */
+enum MazeLayout {
+    LAYOUT_ROW_MAJOR = 0,
+    LAYOUT_TILED = 1
+};
+
+#define TILE_SHIFT 6
+#define TILE_SIZE ((size_t) 1 << TILE_SHIFT)
+#define TILE_MASK (TILE_SIZE - 1)
+
+struct Maze;
+
+/**
+ * A view of a single location in a Maze.
+ *
+ * The links between cells are stored in the Maze grid, a Cell only records
+ * where it is so the older pointer based functions keep working.
+ */
 typedef struct Cell {
     int x, y;
-    unsigned int neighbour_count;
-    struct Cell **neighbours;
+    struct Maze *maze;
 } Cell;
 
 /**
- * Creates a new Cell with the given x, y coordinates
- * @param x The x coordinate
- * @param y The y coordinate
- * @return A pointer to the new Cell
+ * Maze data type.
+ *
+ * Holds the width and height as well as the packed grid of cells.
+ *
+ * The grid has a border of MISSING_CELL entries around it so moving one step
+ * in any direction from a cell in the maze never needs a bounds check.
+ * Where each cell lives in the grid depends on the layout, so the grid should
+ * only be walked with index_at and get_index_adjacent.
+ * The cells array is a view of the grid as Cell entries.
+ *
+ * The Maze and its grid share a single allocation. The cells are only
+ * allocated the first time a Cell is asked for, so mazes only worked on
+ * through grid indexes cost a single byte per cell. That makes the cells a
+ * second block, so delete_maze can have up to three blocks to free: the
+ * maze, the cells and the live cell list below.
+ *
+ * The cells are a cache filled in even through a const Maze and this is not
+ * thread safe. Two threads asking for a Cell of the same maze for the first
+ * time race on creating them, so call get_cell_view before sharing a maze
+ * between threads that use Cells.
+ *
+ * The MISSING_CELL bits of the grid are the mask of which cells are part of
+ * the maze. live_cells is a list of the grid index of every cell in the
+ * maze, built by get_live_cells when it is first needed after the mask
+ * changes. It takes 8 bytes a cell so is only built for mazes with cells
+ * missing, full mazes go straight to the grid. Like the cells it is a cache
+ * filled in through a const Maze and is not thread safe, so call
+ * get_live_cells before sharing a masked maze between threads that pick
+ * random cells from it.
  */
-Cell *new_cell(int x, int y) {
-    Cell *cell = malloc(sizeof(Cell));
-    if (cell == NULL) {
-        fprintf(stderr, "Unable to create cell: %dx%d", x, y);
+typedef struct Maze {
+    int width;
+    int height;
+    Cell *cells;
+    size_t cell_count;
+    enum MazeLayout layout;
+    // row length for LAYOUT_ROW_MAJOR or tile row length for LAYOUT_TILED
+    size_t stride;
+    size_t grid_size;
+    unsigned char *grid;
+    // how to move one cell in each direction, see get_index_adjacent
+    ptrdiff_t steps[DIRECTION_COUNT];
+    size_t step_masks[DIRECTION_COUNT];
+    size_t step_edges[DIRECTION_COUNT];
+    size_t *live_cells;
+    bool live_cells_valid;
+    // the seed the maze was generated from, written out with it
+    uint64_t seed;
+} Maze;
+
+typedef struct {
+    bool north, east, south, west;
+} Directions;
+
+/**
+ * Multiply two sizes together, exiting if the result does not fit in a size_t.
+ * @param a The first size
+ * @param b The second size
+ * @return a * b
+ */
+size_t checked_size_multiply(size_t a, size_t b) {
+    if (a != 0 && b > SIZE_MAX / a) {
+        fprintf(stderr, "Size overflow: %zu * %zu", a, b);
         exit(EXIT_FAILURE);
     }
-    cell->x = x;
-    cell->y = y;
+    return a * b;
+}
+
+/**
+ * Add two sizes together, exiting if the result does not fit in a size_t.
+ * @param a The first size
+ * @param b The second size
+ * @return a + b
+ */
+size_t checked_size_add(size_t a, size_t b) {
+    if (b > SIZE_MAX - a) {
+        fprintf(stderr, "Size overflow: %zu + %zu", a, b);
+        exit(EXIT_FAILURE);
+    }
+    return a + b;
+}
+
+/**
+ * Gets the grid index of a location in the padded grid, where (0,0) is the
+ * top left of the border.
+ * @param maze The maze
+ * @param grid_x The x location in the padded grid
+ * @param grid_y The y location in the padded grid
+ * @return The index of the location in the grid
+ */
+size_t grid_index(const Maze *maze, size_t grid_x, size_t grid_y) {
+    switch (maze->layout) {
+        case LAYOUT_TILED: {
+            size_t tile = ((grid_y >> TILE_SHIFT) * maze->stride) + (grid_x >> TILE_SHIFT);
+            return (tile << (2 * TILE_SHIFT)) | ((grid_y & TILE_MASK) << TILE_SHIFT) | (grid_x & TILE_MASK);
+        }
+        default:
+            return (grid_y * maze->stride) + grid_x;
+    }
+}
+
+/**
+ * Gets the location in the padded grid of a grid index.
+ * @param maze The maze
+ * @param index The grid index
+ * @param grid_x Filled with the x location in the padded grid
+ * @param grid_y Filled with the y location in the padded grid
+ */
+void grid_location(const Maze *maze, size_t index, size_t *grid_x, size_t *grid_y) {
+    switch (maze->layout) {
+        case LAYOUT_TILED: {
+            size_t tile = index >> (2 * TILE_SHIFT);
+            *grid_x = ((tile % maze->stride) << TILE_SHIFT) | (index & TILE_MASK);
+            *grid_y = ((tile / maze->stride) << TILE_SHIFT) | ((index >> TILE_SHIFT) & TILE_MASK);
+            break;
+        }
+        default:
+            *grid_x = index % maze->stride;
+            *grid_y = index / maze->stride;
+            break;
+    }
+}
+
+/**
+ * Gets the grid index of the given x,y coordinate.
+ *
+ * Coordinates from -1 up to and including the width/height are valid and
+ * refer to the sentinel border.
+ * @param maze The maze
+ * @param x The x location of the cell
+ * @param y The y location of the cell
+ * @return The index of (x,y) in the grid
+ */
+size_t index_at(const Maze *maze, int x, int y) {
+    return grid_index(maze, (size_t) (x + 1), (size_t) (y + 1));
+}
+
+int index_x(const Maze *maze, size_t index) {
+    size_t grid_x, grid_y;
+    grid_location(maze, index, &grid_x, &grid_y);
+    return (int) grid_x - 1;
+}
+
+int index_y(const Maze *maze, size_t index) {
+    size_t grid_x, grid_y;
+    grid_location(maze, index, &grid_x, &grid_y);
+    return (int) grid_y - 1;
+}
+
+/**
+ * Gets the grid index adjacent to the given one in the given direction.
+ *
+ * No bounds checking is done, the sentinel border means this is always valid
+ * for an index that is in the maze.
+ * @param maze The maze
+ * @param index The current index
+ * @param direction The direction to look in
+ * @return The index in that direction
+ */
+size_t get_index_adjacent(const Maze *maze, size_t index, int direction) {
+    switch (maze->layout) {
+        case LAYOUT_ROW_MAJOR:
+            return (size_t) ((ptrdiff_t) index + maze->steps[direction]);
+        case LAYOUT_TILED:
+            // steps only work inside a tile, not across the edge of one
+            if ((index & maze->step_masks[direction]) != maze->step_edges[direction]) {
+                return (size_t) ((ptrdiff_t) index + maze->steps[direction]);
+            }
+            break;
+        default:
+            break;
+    }
+    size_t grid_x, grid_y;
+    grid_location(maze, index, &grid_x, &grid_y);
+    switch (direction) {
+        case NORTH:
+            return grid_index(maze, grid_x, grid_y - 1);
+        case EAST:
+            return grid_index(maze, grid_x + 1, grid_y);
+        case SOUTH:
+            return grid_index(maze, grid_x, grid_y + 1);
+        default:
+            return grid_index(maze, grid_x - 1, grid_y);
+    }
+}
+
+/**
+ * @param maze The maze
+ * @param index The grid index
+ * @return true if there is a cell at the index, false if it is missing or part
+ * of the border
+ */
+bool index_in_maze(const Maze *maze, size_t index) {
+    return (maze->grid[index] & MISSING_CELL) == 0;
+}
+
+/**
+ * @param maze The maze
+ * @param index The grid index
+ * @return The open walls of the cell at index as DIRECTION_BIT flags
+ */
+unsigned int get_open_walls(const Maze *maze, size_t index) {
+    return maze->grid[index] & OPEN_WALLS_MASK;
+}
+
+/**
+ * @param maze The maze
+ * @param x The first cell
+ * @param count The most cells wanted
+ * @return How many cells along a row from x are next to each other in the grid
+ */
+size_t contiguous_row_cells(const Maze *maze, int x, size_t count) {
+    size_t run;
+    switch (maze->layout) {
+        case LAYOUT_ROW_MAJOR:
+            return count;
+        case LAYOUT_TILED:
+            // up to the end of the tile
+            run = TILE_SIZE - (((size_t) x + 1) & TILE_MASK);
+            return run < count ? run : count;
+        default:
+            return 1;
+    }
+}
+
+/**
+ * Copy packed cells into part of a row of the grid.
+ * @param maze The maze
+ * @param x The first cell to write
+ * @param y The row
+ * @param cells The cells, one byte each in the same format as the grid
+ * @param count How many cells to write
+ */
+void write_row_cells(const Maze *maze, int x, int y, const unsigned char *cells, size_t count) {
+    size_t index = index_at(maze, x, y);
+    size_t done = 0;
+    while (done < count) {
+        size_t run = contiguous_row_cells(maze, x + (int) done, count - done);
+        memcpy(maze->grid + index, cells + done, run);
+        done += run;
+        index = get_index_adjacent(maze, index + run - 1, EAST);
+    }
+}
+
+/**
+ * Copy packed cells out of part of a row of the grid.
+ * @param maze The maze
+ * @param x The first cell to read
+ * @param y The row
+ * @param cells Filled with the cells, one byte each
+ * @param count How many cells to read
+ */
+void read_row_cells(const Maze *maze, int x, int y, unsigned char *cells, size_t count) {
+    size_t index = index_at(maze, x, y);
+    size_t done = 0;
+    while (done < count) {
+        size_t run = contiguous_row_cells(maze, x + (int) done, count - done);
+        memcpy(cells + done, maze->grid + index, run);
+        done += run;
+        index = get_index_adjacent(maze, index + run - 1, EAST);
+    }
+}
+
+/**
+ * @param maze The maze
+ * @param index The grid index
+ * @return The directions that have a cell next to the one at index as
+ * DIRECTION_BIT flags
+ */
+unsigned int get_neighbour_mask(const Maze *maze, size_t index) {
+    unsigned int mask = 0;
+    for (int dir = 0; dir < DIRECTION_COUNT; dir++) {
+        size_t adjacent = get_index_adjacent(maze, index, dir);
+        mask |= (unsigned int) index_in_maze(maze, adjacent) << (unsigned int) dir;
+    }
+    return mask;
+}
+
+/**
+ * @param maze The maze
+ * @param x The x location of the cell
+ * @param y The y location of the cell
+ * @return The directions that lead out of the edge of the maze from the cell
+ * at x,y as DIRECTION_BIT flags
+ */
+unsigned int get_edge_mask(const Maze *maze, int x, int y) {
+    unsigned int mask = 0;
+    if (y == 0) mask |= DIRECTION_BIT(NORTH);
+    if (x == maze->width - 1) mask |= DIRECTION_BIT(EAST);
+    if (y == maze->height - 1) mask |= DIRECTION_BIT(SOUTH);
+    if (x == 0) mask |= DIRECTION_BIT(WEST);
+    return mask;
+}
+
+/**
+ * Link the cell at index with the one next to it in the given direction.
+ *
+ * Nothing happens if either cell is missing.
+ * @param maze The maze
+ * @param index The grid index of the cell
+ * @param dir The direction to link in
+ */
+void link_index_in_dir(const Maze *maze, size_t index, int dir) {
+    size_t neighbour = get_index_adjacent(maze, index, dir);
+    if (((maze->grid[index] | maze->grid[neighbour]) & MISSING_CELL) != 0) {
+        return;
+    }
+    maze->grid[index] |= DIRECTION_BIT(dir);
+    maze->grid[neighbour] |= DIRECTION_BIT(opposite_direction(dir));
+}
+
+/**
+ * Unlink the cell at index from the one next to it in the given direction.
+ * @param maze The maze
+ * @param index The grid index of the cell
+ * @param dir The direction to unlink
+ */
+void unlink_index_in_dir(const Maze *maze, size_t index, int dir) {
+    size_t neighbour = get_index_adjacent(maze, index, dir);
+    maze->grid[index] &= ~DIRECTION_BIT(dir);
+    maze->grid[neighbour] &= ~DIRECTION_BIT(opposite_direction(dir));
+}
 
-    // fixed count of potential neighbours in cardinal directions only
-    cell->neighbour_count = DIRECTION_COUNT;
-    cell->neighbours = malloc(sizeof(Cell *) * cell->neighbour_count);
-    if (cell->neighbours == NULL) {
-        fprintf(stderr, "Unable to allocate space for neighbours on cell %dx%d", x, y);
-        free(cell);
+/**
+ * Remove the cell at the given grid index from the maze, unlinking it from
+ * it's neighbours.
+ * @param maze The maze
+ * @param index The grid index of the cell
+ */
+void remove_index(Maze *maze, size_t index) {
+    if (!index_in_maze(maze, index)) return;
+    for (int dir = 0; dir < DIRECTION_COUNT; dir++) {
+        unlink_index_in_dir(maze, index, dir);
+    }
+    maze->grid[index] = MISSING_CELL;
+    maze->cell_count--;
+    maze->live_cells_valid = false;
+}
+
+/**
+ * Gets the grid index of every cell in the maze, in row order.
+ *
+ * The list is rebuilt the first time it is asked for after cells are
+ * removed and has maze->cell_count entries. Rebuilding it is not thread
+ * safe, see Maze.
+ * @param maze The maze
+ * @return The grid indexes of all cells in the maze
+ */
+const size_t *get_live_cells(const Maze *maze) {
+    if (maze->live_cells_valid) {
+        return maze->live_cells;
+    }
+    // The list is a cache of the grid so is filled in even on a const Maze
+    Maze *cache = (Maze *) maze;
+    size_t bytes = checked_size_multiply(sizeof(size_t), maze->cell_count == 0 ? 1 : maze->cell_count);
+    size_t *live_cells = realloc(cache->live_cells, bytes);
+    if (live_cells == NULL) {
+        fprintf(stderr, "Unable to allocate live cell list");
         exit(EXIT_FAILURE);
     }
-    for (int i = 0; i < cell->neighbour_count; i++) {
-        cell->neighbours[i] = NULL;
+    size_t count = 0;
+    for (int y = 0; y < maze->height; y++) {
+        size_t index = index_at(maze, 0, y);
+        for (int x = 0; x < maze->width; x++, index = get_index_adjacent(maze, index, EAST)) {
+            if (index_in_maze(maze, index)) {
+                live_cells[count++] = index;
+            }
+        }
     }
-    return cell;
+    cache->live_cells = live_cells;
+    cache->live_cells_valid = true;
+    return live_cells;
+}
+
+Directions directions_from_walls(unsigned int walls) {
+    Directions dirs;
+    dirs.north = walls & DIRECTION_BIT(NORTH);
+    dirs.east = walls & DIRECTION_BIT(EAST);
+    dirs.south = walls & DIRECTION_BIT(SOUTH);
+    dirs.west = walls & DIRECTION_BIT(WEST);
+    return dirs;
+}
+
+size_t cell_index(const Cell *cell) {
+    return index_at(cell->maze, cell->x, cell->y);
+}
+
+/**
+ * Finds the direction cell2 is in from cell1.
+ * @param cell1 The cell to look from
+ * @param cell2 The cell to look for
+ * @return -1 if the cells are not adjacent, otherwise the direction of cell2
+ */
+int direction_between(const Cell *cell1, const Cell *cell2) {
+    if (cell1 == NULL || cell2 == NULL || cell1->maze != cell2->maze) {
+        return -1;
+    }
+    int x_diff = cell2->x - cell1->x;
+    int y_diff = cell2->y - cell1->y;
+    if (x_diff == 0 && y_diff == -1) return NORTH;
+    if (x_diff == 1 && y_diff == 0) return EAST;
+    if (x_diff == 0 && y_diff == 1) return SOUTH;
+    if (x_diff == -1 && y_diff == 0) return WEST;
+    return -1;
 }
 
 /**
- * Returns the position of the cell_to_find in the cell_to_search's neighbours
- * array.
+ * Returns the direction cell_to_find is linked to from cell_to_search.
  *
  * Will be -1 if not found.
  * @param cell_to_search
  * @param cell_to_find
- * @return -1 if not found otherwise index of cell_to_find in cell_to_search's
- * neighbours array.
+ * @return -1 if not found otherwise the direction of the link from
+ * cell_to_search to cell_to_find.
  */
 int neighbour_pos(const Cell *cell_to_search, const Cell *cell_to_find) {
-    if (cell_to_search == NULL || cell_to_find == NULL) {
+    int dir = direction_between(cell_to_search, cell_to_find);
+    if (dir == -1) {
         return -1;
     }
-    for (int i = 0; i < cell_to_search->neighbour_count; i++) {
-        Cell *n = cell_to_search->neighbours[i];
-        if (n == cell_to_find) {
-            return i;
-        }
+    if (get_open_walls(cell_to_search->maze, cell_index(cell_to_search)) & DIRECTION_BIT(dir)) {
+        return dir;
     }
     return -1;
 }
 
 /**
- * Deletes the cell
+ * Deletes the cell by removing it from it's maze.
+ *
+ * The memory for the cell belongs to the maze so is not freed. A missing cell
+ * can never be linked to, so it is always removed from it's neighbours.
  * @param cell A pointer to the cell to delete
- * @param remove_from_neighbours Whether a pointer to the cell should be
- * removed form it's neighbours
+ * @param remove_from_neighbours Unused, kept for compatibility
  */
 void delete_cell(Cell *cell, const bool remove_from_neighbours) {
-    if (remove_from_neighbours) {
-        for (int i = 0; i < cell->neighbour_count; i++) {
-            Cell *neighbour = cell->neighbours[i];
-            if (neighbour != NULL) {
-                int my_pos = neighbour_pos(neighbour, cell);
-                if (my_pos != -1) {
-                    neighbour->neighbours[my_pos] = NULL;
-                }
-            }
-        }
-    }
-    free(cell);
-    cell = NULL;
+    (void) remove_from_neighbours;
+    if (cell == NULL) return;
+    remove_index(cell->maze, cell_index(cell));
 }
 
 /**
- * Maze data type.
+ * Gets the Cell view of the maze, creating it the first time it is needed.
  *
- * Holds the width and height as well as Cell entries.
+ * Cells are stored in row order. Creating the view is not thread safe, see
+ * Maze.
+ * @param maze The maze
+ * @return A pointer to the first Cell
  */
-typedef struct {
-    int width;
-    int height;
-    Cell **cells;
-    int cell_count;
-} Maze;
+Cell *get_cell_view(const Maze *maze) {
+    if (maze->cells != NULL) {
+        return maze->cells;
+    }
+    const int width = maze->width;
+    const int height = maze->height;
+    size_t count = checked_size_multiply((size_t) width, (size_t) height);
+    Cell *cells = malloc(checked_size_multiply(sizeof(Cell), count));
+    if (cells == NULL) {
+        fprintf(stderr, "Unable to create cells");
+        exit(EXIT_FAILURE);
+    }
+    Cell *cell = cells;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++, cell++) {
+            cell->x = x;
+            cell->y = y;
+            cell->maze = (Maze *) maze;
+        }
+    }
+    // The view is a cache of the grid so is filled in even on a const Maze
+    ((Maze *) maze)->cells = cells;
+    return cells;
+}
 
 /**
  * Gets the Cell at the given x,y coordinate
@@ -135,7 +570,10 @@ Cell *cell_at(const Maze *maze, int x, int y) {
     if (x >= width || y >= height || x < 0 || y < 0) {
         return NULL;
     }
-    return maze->cells[(y * width) + x];
+    if (!index_in_maze(maze, index_at(maze, x, y))) {
+        return NULL;
+    }
+    return &get_cell_view(maze)[((size_t) y * width) + x];
 }
 
 /**
@@ -151,43 +589,54 @@ Cell *get_cell_adjacent(const Maze *maze, const Cell *cell, int direction) {
     if (direction < NORTH || direction > WEST || maze == NULL || cell == NULL) {
         return NULL;
     }
-    const int x = cell->x, y = cell->y;
-    switch (direction) {
-        case NORTH:
-            return cell_at(maze, x, y - 1);
-        case EAST:
-            return cell_at(maze, x + 1, y);
-        case SOUTH:
-            return cell_at(maze, x, y + 1);
-        case WEST:
-            return cell_at(maze, x - 1, y);
-        default:
-            fprintf(stderr, "Unhandled direction: %d", direction);
-            exit(EXIT_FAILURE);
+    size_t adjacent = get_index_adjacent(maze, cell_index(cell), direction);
+    if (!index_in_maze(maze, adjacent)) {
+        return NULL;
     }
+    const size_t row = (size_t) index_y(maze, adjacent) * maze->width;
+    return &get_cell_view(maze)[row + index_x(maze, adjacent)];
 }
 
 
 /**
- * Sets all the neighbour values in a cell to those surrounding it in the maze
+ * Links a cell to all of the cells surrounding it in the maze
  * @param maze The maze
  * @param cell The cell to work on
  */
 void set_all_neighbouring_cells(const Maze *maze, const Cell *cell) {
     if (maze == NULL || cell == NULL) return;
-    Cell *north = get_cell_adjacent(maze, cell, NORTH);
-    Cell *east = get_cell_adjacent(maze, cell, EAST);
-    Cell *south = get_cell_adjacent(maze, cell, SOUTH);
-    Cell *west = get_cell_adjacent(maze, cell, WEST);
+    size_t index = cell_index(cell);
+    for (int dir = 0; dir < DIRECTION_COUNT; dir++) {
+        link_index_in_dir(maze, index, dir);
+    }
+}
 
-    cell->neighbours[NORTH] = north;
-    cell->neighbours[EAST] = east;
-    cell->neighbours[SOUTH] = south;
-    cell->neighbours[WEST] = west;
+/**
+ * Get all neighbouring cells to a given cell without allocating.
+ * @param maze The maze
+ * @param cell The cell to get neighbours of
+ * @param neighbours Filled with the neighbour in each direction, NULL where
+ * there is no cell
+ * @return The directions that have a neighbour as DIRECTION_BIT flags
+ */
+unsigned int get_neighbouring_cells(
+        const Maze *maze,
+        const Cell *cell,
+        Cell *neighbours[DIRECTION_COUNT]
+) {
+    unsigned int mask = 0;
+    for (int dir = 0; dir < DIRECTION_COUNT; dir++) {
+        neighbours[dir] = get_cell_adjacent(maze, cell, dir);
+        if (neighbours[dir] != NULL) mask |= DIRECTION_BIT(dir);
+    }
+    return mask;
 }
 
 /**
- * Get all neighbouring cells to a given cell
+ * Get all neighbouring cells to a given cell.
+ *
+ * This allocates the array on every call, get_neighbouring_cells or
+ * get_neighbour_mask do the same without allocating.
  * @param maze The maze
  * @param cell The cell to get neighbours of
  * @param size A pointer to an integer that will be filled with the size of the
@@ -208,10 +657,7 @@ Cell **get_all_neighbouring_cells(
         fprintf(stderr, "Unable to allocate array");
         exit(EXIT_FAILURE);
     }
-    array[NORTH] = get_cell_adjacent(maze, cell, NORTH);
-    array[EAST] = get_cell_adjacent(maze, cell, EAST);
-    array[SOUTH] = get_cell_adjacent(maze, cell, SOUTH);
-    array[WEST] = get_cell_adjacent(maze, cell, WEST);
+    get_neighbouring_cells(maze, cell, array);
     *size = DIRECTION_COUNT;
     return array;
 }
@@ -219,16 +665,10 @@ Cell **get_all_neighbouring_cells(
 
 void unlink_all_cells(const Maze *maze) {
     if (maze == NULL) return;
-    const int width = maze->width;
-    const int height = maze->height;
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            Cell *cell = maze->cells[(y * width) + x];
-            if (cell == NULL) continue;
-            for (int i = 0; i < cell->neighbour_count; i++) {
-                cell->neighbours[i] = NULL;
-            }
-        }
+    const size_t grid_size = maze->grid_size;
+    unsigned char *grid = maze->grid;
+    for (size_t i = 0; i < grid_size; i++) {
+        grid[i] &= MISSING_CELL;
     }
 }
 
@@ -237,19 +677,55 @@ void link_all_adjacent_cells(const Maze *maze) {
     const int width = maze->width;
     const int height = maze->height;
     for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            Cell *cell = maze->cells[(y * width) + x];
-            set_all_neighbouring_cells(maze, cell);
+        size_t index = index_at(maze, 0, y);
+        for (int x = 0; x < width; x++, index = get_index_adjacent(maze, index, EAST)) {
+            if (!index_in_maze(maze, index)) continue;
+            link_index_in_dir(maze, index, EAST);
+            link_index_in_dir(maze, index, SOUTH);
         }
     }
 }
 
-Maze *new_maze(int width, int height, bool all_linked) {
-    if (width <= 0 || height <= 0) {
+/**
+ * Create a new maze with its grid stored in the given layout.
+ *
+ * The layout only changes where cells live in memory, every function working
+ * on a maze gives the same results whatever the layout is.
+ * @param width The width in cells
+ * @param height The height in cells
+ * @param all_linked Whether all the cells should start linked to their
+ * neighbours
+ * @param layout The layout of the grid
+ * @return A pointer to the new maze
+ */
+Maze *new_maze_with_layout(int width, int height, bool all_linked, enum MazeLayout layout) {
+    if (width <= 0 || height <= 0 || width > MAX_MAZE_DIMENSION || height > MAX_MAZE_DIMENSION) {
         fprintf(stderr, "Cannot create a maze with dimensions: %dx%d", width, height);
         exit(EXIT_FAILURE);
     }
-    Maze *maze = malloc(sizeof(Maze));
+    const size_t grid_width = (size_t) width + 2;
+    const size_t grid_height = (size_t) height + 2;
+    size_t stride = grid_width;
+    ptrdiff_t vertical_step = (ptrdiff_t) grid_width;
+    size_t grid_size;
+    switch (layout) {
+        case LAYOUT_ROW_MAJOR:
+            grid_size = checked_size_multiply(grid_width, grid_height);
+            break;
+        case LAYOUT_TILED: {
+            stride = (grid_width + TILE_MASK) >> TILE_SHIFT;
+            size_t tiles = checked_size_multiply(stride, (grid_height + TILE_MASK) >> TILE_SHIFT);
+            grid_size = checked_size_multiply(tiles, TILE_SIZE * TILE_SIZE);
+            vertical_step = (ptrdiff_t) TILE_SIZE;
+            break;
+        }
+        default:
+            fprintf(stderr, "Unknown maze layout: %d", layout);
+            exit(EXIT_FAILURE);
+    }
+
+    // Layout is the Maze followed by the grid
+    Maze *maze = malloc(checked_size_add(sizeof(Maze), grid_size));
     if (maze == NULL) {
         fprintf(stderr, "Unable to create maze");
         exit(EXIT_FAILURE);
@@ -257,18 +733,39 @@ Maze *new_maze(int width, int height, bool all_linked) {
 
     maze->width = width;
     maze->height = height;
-    maze->cells = malloc(sizeof(Cell *) * width * height);
-    if (maze->cells == NULL) {
-        fprintf(stderr, "Unable to create cells");
-        free(maze);
-        exit(EXIT_FAILURE);
-    }
-    maze->cell_count = width * height;
-
+    maze->cells = NULL;
+    maze->cell_count = (size_t) width * height;
+    maze->live_cells = NULL;
+    maze->live_cells_valid = false;
+    maze->seed = 0;
+    maze->layout = layout;
+    maze->stride = stride;
+    maze->grid_size = grid_size;
+    maze->grid = (unsigned char *) (maze + 1);
+    maze->steps[NORTH] = -vertical_step;
+    maze->steps[EAST] = 1;
+    maze->steps[SOUTH] = vertical_step;
+    maze->steps[WEST] = -1;
+    if (layout == LAYOUT_TILED) {
+        maze->step_masks[NORTH] = TILE_MASK << TILE_SHIFT;
+        maze->step_masks[EAST] = TILE_MASK;
+        maze->step_masks[SOUTH] = TILE_MASK << TILE_SHIFT;
+        maze->step_masks[WEST] = TILE_MASK;
+        maze->step_edges[NORTH] = 0;
+        maze->step_edges[EAST] = TILE_MASK;
+        maze->step_edges[SOUTH] = TILE_MASK << TILE_SHIFT;
+        maze->step_edges[WEST] = 0;
+    }
+
+    // Everything starts missing and the cells inside the border are cleared
+    memset(maze->grid, MISSING_CELL, grid_size);
     for (int y = 0; y < height; y++) {
+        if (layout == LAYOUT_ROW_MAJOR) {
+            memset(maze->grid + index_at(maze, 0, y), 0, (size_t) width);
+            continue;
+        }
         for (int x = 0; x < width; x++) {
-            Cell *cell = new_cell(x, y);
-            maze->cells[(y * width) + x] = cell;
+            maze->grid[index_at(maze, x, y)] = 0;
         }
     }
 
@@ -279,6 +776,26 @@ Maze *new_maze(int width, int height, bool all_linked) {
     return maze;
 }
 
+/**
+ * @param name The name of a layout, row or tiled
+ * @param layout Filled with the layout
+ * @return false if the name is not a layout
+ */
+bool maze_layout_from_name(const char *name, enum MazeLayout *layout) {
+    if (strcmp(name, "row") == 0) {
+        *layout = LAYOUT_ROW_MAJOR;
+    } else if (strcmp(name, "tiled") == 0) {
+        *layout = LAYOUT_TILED;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+Maze *new_maze(int width, int height, bool all_linked) {
+    return new_maze_with_layout(width, height, all_linked, LAYOUT_ROW_MAJOR);
+}
+
 
 /**
  * Remove a cell from a maze and delete it.
@@ -290,44 +807,25 @@ Maze *new_maze(int width, int height, bool all_linked) {
  */
 void remove_cell(Maze *maze, int x, int y) {
     if (maze == NULL) return;
-    int width = maze->width;
-    Cell *cell = cell_at(maze, x, y);
-    if (cell != NULL) {
-        delete_cell(cell, true);
-        maze->cells[(y * width) + x] = NULL;
-        maze->cell_count--;
-    }
+    if (x >= maze->width || y >= maze->height || x < 0 || y < 0) return;
+    remove_index(maze, index_at(maze, x, y));
 }
 
+/**
+ * Delete a maze along with all of it's cells and it's live cell list, which
+ * are separate blocks to the maze and grid
+ * @param maze The maze
+ */
 void delete_maze(Maze *maze) {
-    int width = maze->width;
-    int height = maze->height;
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            Cell *cell = cell_at(maze, x, y);
-            delete_cell(cell, false);
-        }
-    }
-    maze->cell_count = 0;
+    free(maze->live_cells);
     free(maze->cells);
-    maze->cells = NULL;
     free(maze);
-    maze = NULL;
 }
 
 void unlink_cells(const Cell *cell1, const Cell *cell2) {
-    if (cell1 == NULL || cell2 == NULL) {
-        return;
-    }
-    int cell2_pos = neighbour_pos(cell1, cell2);
-    if (cell2_pos != -1) {
-        cell1->neighbours[cell2_pos] = NULL;
-    }
-
-    int cell1_pos = neighbour_pos(cell2, cell1);
-    if (cell1_pos != -1) {
-        cell2->neighbours[cell1_pos] = NULL;
+    int dir = neighbour_pos(cell1, cell2);
+    if (dir != -1) {
+        unlink_index_in_dir(cell1->maze, cell_index(cell1), dir);
     }
 }
 
@@ -335,44 +833,14 @@ void unlink_cell_in_dir(const Cell *cell, int dir) {
     if (cell == NULL || dir < NORTH || dir > WEST) {
         return;
     }
-    Cell *neighbour = cell->neighbours[dir];
-    if (neighbour != NULL) {
-        int my_pos = neighbour_pos(neighbour, cell);
-        if (my_pos != -1) {
-            neighbour->neighbours[my_pos] = NULL;
-        }
-        cell->neighbours[dir] = NULL;
-    }
+    unlink_index_in_dir(cell->maze, cell_index(cell), dir);
 }
 
 void link_cell_in_dir(const Maze *maze, const Cell *cell, int dir) {
     if (maze == NULL || cell == NULL || dir < NORTH || dir > WEST) {
         return;
     }
-    Cell *neighbour = get_cell_adjacent(maze, cell, dir);
-    if (neighbour != NULL) {
-        cell->neighbours[dir] = neighbour;
-        int my_pos;
-        switch (dir) {
-            case NORTH:
-                my_pos = SOUTH;
-                break;
-            case EAST:
-                my_pos = WEST;
-                break;
-            case SOUTH:
-                my_pos = NORTH;
-                break;
-            case WEST:
-                my_pos = EAST;
-                break;
-            default:
-                my_pos = -1;
-        }
-        if (my_pos != -1) {
-            neighbour->neighbours[my_pos] = (Cell *) cell;
-        }
-    }
+    link_index_in_dir(maze, cell_index(cell), dir);
 }
 
 /**
@@ -383,64 +851,19 @@ void link_cell_in_dir(const Maze *maze, const Cell *cell, int dir) {
  * @param cell2 Second cell
  */
 void link_adjacent_cells(const Cell *cell1, const Cell *cell2) {
-    if (cell1 == NULL || cell2 == NULL || cell1 == cell2) {
-        return;
-    }
-
-    int x_diff = cell1->x - cell2->x;
-    int y_diff = cell1->y - cell2->y;
-
-    int abs_x = abs(x_diff);
-    int abs_y = abs(y_diff);
-    if (abs_x > 1 || abs_y > 1 || (abs_x == 1 && abs_y == 1)) {
+    int dir = direction_between(cell1, cell2);
+    if (dir == -1) {
         // these cells are not next to each other, or are diagonals
         return;
     }
-
-    int cell1_dir;
-    int cell2_dir;
-    if (x_diff != 0) {
-        if (x_diff > 0) {
-            cell1_dir = WEST;
-            cell2_dir = EAST;
-        } else {
-            cell1_dir = EAST;
-            cell2_dir = WEST;
-        }
-    } else if (y_diff != 0) {
-        if (y_diff > 0) {
-            cell1_dir = NORTH;;
-            cell2_dir = SOUTH;;
-        } else {
-            cell1_dir = SOUTH;
-            cell2_dir = NORTH;
-        }
-    } else {
-        return;
-    }
-
-    cell1->neighbours[cell1_dir] = (Cell *) cell2;
-    cell2->neighbours[cell2_dir] = (Cell *) cell1;
+    link_index_in_dir(cell1->maze, cell_index(cell1), dir);
 }
 
-typedef struct {
-    bool north, east, south, west;
-} Directions;
-
 Directions get_unblocked_directions(const Cell *cell) {
-    Directions dirs;
     if (cell == NULL) {
-        dirs.north = false;
-        dirs.east = false;
-        dirs.south = false;
-        dirs.west = false;
-    } else {
-        dirs.north = cell->neighbours[NORTH];
-        dirs.east = cell->neighbours[EAST];
-        dirs.south = cell->neighbours[SOUTH];
-        dirs.west = cell->neighbours[WEST];
+        return directions_from_walls(0);
     }
-    return dirs;
+    return directions_from_walls(get_open_walls(cell->maze, cell_index(cell)));
 }
 
 Directions get_blocked_directions(const Cell *cell) {
@@ -461,13 +884,13 @@ void print_maze(const Maze *maze) {
     const int height = maze->height;
 
     for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            Cell *cell = cell_at(maze, x, y);
-            if (cell == NULL) {
+        size_t index = index_at(maze, 0, y);
+        for (int x = 0; x < width; x++, index = get_index_adjacent(maze, index, EAST)) {
+            if (!index_in_maze(maze, index)) {
                 printf("#");
                 continue;
             }
-            Directions dirs = get_unblocked_directions(cell);
+            Directions dirs = directions_from_walls(get_open_walls(maze, index));
             if (dirs.north && dirs.east && dirs.south && dirs.west) {
                 printf("╬");
             } else if (dirs.north && dirs.east && dirs.south) {
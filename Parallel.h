@@ -0,0 +1,98 @@
+#ifndef MAZE_PARALLEL_H
+#define MAZE_PARALLEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// the most threads run_parallel will use
+#define MAX_PARALLEL_THREADS 256
+
+/**
+ * A task run by run_parallel on every job from start up to but not including
+ * end.
+ */
+typedef void (*ParallelTask)(void *data, size_t start, size_t end);
+
+typedef struct {
+    ParallelTask task;
+    void *data;
+    size_t job_count;
+    size_t chunk;
+    atomic_size_t next;
+} ParallelJobs;
+
+/**
+ * @return The number of processors available, at least 1
+ */
+int available_threads() {
+#ifdef _SC_NPROCESSORS_ONLN
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1) return 1;
+    if (count > MAX_PARALLEL_THREADS) return MAX_PARALLEL_THREADS;
+    return (int) count;
+#else
+    return 1;
+#endif
+}
+
+void *parallel_worker(void *argument) {
+    ParallelJobs *jobs = argument;
+    for (;;) {
+        size_t start = atomic_fetch_add(&jobs->next, jobs->chunk);
+        if (start >= jobs->job_count) break;
+        size_t end = start + jobs->chunk;
+        if (end > jobs->job_count) end = jobs->job_count;
+        jobs->task(jobs->data, start, end);
+    }
+    return NULL;
+}
+
+/**
+ * Run a task over a number of jobs split across threads.
+ *
+ * Jobs are handed out in chunks to whichever thread is free, so the task must
+ * give the same result whichever thread runs a job and in whatever order.
+ * The calling thread works too and this returns once every job is done.
+ * @param thread_count The most threads to use, 1 or less runs every job on
+ * the calling thread
+ * @param job_count The number of jobs
+ * @param task The task to run
+ * @param data Passed to the task
+ */
+void run_parallel(int thread_count, size_t job_count, ParallelTask task, void *data) {
+    if (job_count == 0) return;
+    if (thread_count > MAX_PARALLEL_THREADS) thread_count = MAX_PARALLEL_THREADS;
+    if ((size_t) thread_count > job_count) thread_count = (int) job_count;
+    if (thread_count <= 1) {
+        task(data, 0, job_count);
+        return;
+    }
+
+    ParallelJobs jobs;
+    jobs.task = task;
+    jobs.data = data;
+    jobs.job_count = job_count;
+    // a few chunks per thread so uneven jobs still balance out
+    jobs.chunk = job_count / ((size_t) thread_count * 8);
+    if (jobs.chunk == 0) jobs.chunk = 1;
+    atomic_init(&jobs.next, 0);
+
+    pthread_t threads[MAX_PARALLEL_THREADS];
+    int started = 0;
+    for (int i = 1; i < thread_count; i++) {
+        if (pthread_create(&threads[started], NULL, parallel_worker, &jobs) != 0) {
+            // carry on with the threads we have
+            break;
+        }
+        started++;
+    }
+    parallel_worker(&jobs);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+#endif //MAZE_PARALLEL_H
@@ -0,0 +1,120 @@
+#ifndef MAZE_RANDOM_H
+#define MAZE_RANDOM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * State for a xoshiro256** pseudo random number generator.
+ *
+ * Each generator keeps it's own state so the same seed gives the same
+ * numbers on every machine and separate states can be used from separate
+ * threads.
+ */
+typedef struct {
+    uint64_t state[4];
+} Random;
+
+uint64_t rotate_bits_left(const uint64_t value, int count) {
+    return (value << count) | (value >> (64 - count));
+}
+
+/**
+ * Step a splitmix64 sequence, used to spread a seed over the whole state.
+ * @param seed The sequence position, updated in place
+ * @return The next value in the sequence
+ */
+uint64_t splitmix64_next(uint64_t *seed) {
+    uint64_t z = (*seed += 0x9E3779B97F4A7C15u);
+    z = (z ^ (z >> 30u)) * 0xBF58476D1CE4E5B9u;
+    z = (z ^ (z >> 27u)) * 0x94D049BB133111EBu;
+    return z ^ (z >> 31u);
+}
+
+void seed_random(Random *random, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        random->state[i] = splitmix64_next(&seed);
+    }
+}
+
+/**
+ * Seed one of many independent streams from the same seed.
+ *
+ * Work split across threads can give each piece it's own stream so the
+ * result does not depend on which thread did what.
+ * @param random The random state to seed
+ * @param seed The seed shared by every stream
+ * @param stream The number of the stream
+ */
+void seed_random_stream(Random *random, uint64_t seed, uint64_t stream) {
+    seed_random(random, seed ^ splitmix64_next(&stream));
+}
+
+uint64_t next_random(Random *random) {
+    uint64_t *s = random->state;
+    const uint64_t result = rotate_bits_left(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17u;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotate_bits_left(s[3], 45);
+
+    return result;
+}
+
+/**
+ * Multiply two 64 bit numbers into a 128 bit result.
+ * @param a The first number
+ * @param b The second number
+ * @param low Filled with the low 64 bits of the result
+ * @return The high 64 bits of the result
+ */
+uint64_t multiply_64_to_128(uint64_t a, uint64_t b, uint64_t *low) {
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 product = (unsigned __int128) a * b;
+    *low = (uint64_t) product;
+    return (uint64_t) (product >> 64u);
+#else
+    // long multiplication on 32 bit halves, gives exactly the same bits
+    const uint64_t a_low = a & 0xFFFFFFFFu, a_high = a >> 32u;
+    const uint64_t b_low = b & 0xFFFFFFFFu, b_high = b >> 32u;
+    const uint64_t low_low = a_low * b_low;
+    const uint64_t high_low = a_high * b_low;
+    const uint64_t low_high = a_low * b_high;
+    const uint64_t middle = (low_low >> 32u) + (high_low & 0xFFFFFFFFu) + low_high;
+    *low = (middle << 32u) | (low_low & 0xFFFFFFFFu);
+    return a_high * b_high + (high_low >> 32u) + (middle >> 32u);
+#endif
+}
+
+/**
+ * Get a random number from 0 up to but not including limit.
+ *
+ * Every value is equally likely, unlike taking the random number modulo the
+ * limit. This uses Lemire's multiply and shift on every compiler so the same
+ * seed always gives the same numbers.
+ * @param random The random state
+ * @param limit The upper limit, must be above 0
+ * @return The random number
+ */
+uint64_t random_below(Random *random, uint64_t limit) {
+    uint64_t low;
+    uint64_t result = multiply_64_to_128(next_random(random), limit, &low);
+    // only dividing on the rare retry path
+    if (low < limit) {
+        const uint64_t threshold = -limit % limit;
+        while (low < threshold) {
+            result = multiply_64_to_128(next_random(random), limit, &low);
+        }
+    }
+    return result;
+}
+
+bool random_bool(Random *random) {
+    return next_random(random) >> 63u;
+}
+
+#endif //MAZE_RANDOM_H
@@ -0,0 +1,71 @@
+#ifndef MAZE_ROWSTREAM_H
+#define MAZE_ROWSTREAM_H
+
+#include <stdint.h>
+#include "Maze.h"
+#include "GeneratorContext.h"
+
+/**
+ * Receives a maze one row at a time from a row streaming generator.
+ *
+ * The cells are in the same packed format as a Maze grid and are only valid
+ * until the sink returns. Rows are always given from the top down.
+ * @param data Passed through from the generator
+ * @param cells The cells of the row, one byte each
+ * @param width The number of cells in the row
+ * @return 0 to carry on, anything else stops the generator which then
+ * returns it
+ */
+typedef int (*MazeRowSink)(void *data, const unsigned char *cells, size_t width);
+
+/**
+ * A generator that produces a maze a row at a time, only keeping the state
+ * for a row or two in memory so the height can be as large as needed.
+ * @param width The number of cells in each row
+ * @param height The number of rows
+ * @param context The generator context, for random numbers and scratch
+ * @param sink Given each row in turn
+ * @param data Passed to the sink
+ * @return 0 when every row was generated or the value the sink stopped with
+ */
+typedef int (*RowGenerator)(int width, uint64_t height, GeneratorContext *context, MazeRowSink sink, void *data);
+
+/**
+ * Where maze_row_sink writes to, the next row starts at 0.
+ */
+typedef struct {
+    const Maze *maze;
+    int next_row;
+} MazeRows;
+
+/**
+ * A sink that copies each row into a Maze, data is a MazeRows.
+ */
+int maze_row_sink(void *data, const unsigned char *cells, size_t width) {
+    MazeRows *rows = data;
+    write_row_cells(rows->maze, 0, rows->next_row++, cells, width);
+    return 0;
+}
+
+/**
+ * Generate a whole maze in memory with a row streaming generator.
+ *
+ * Row streaming generators know nothing of missing cells, so this fails for
+ * mazes that have any.
+ * @param maze The maze, it must not have any cells missing
+ * @param context The generator context
+ * @param generator The row streaming generator
+ * @return 0 if successful, -1 if the maze has cells missing
+ */
+int generate_maze_from_rows(const Maze *maze, GeneratorContext *context, RowGenerator generator) {
+    if (maze->cell_count != (size_t) maze->width * maze->height) {
+        fprintf(stderr, "Row streaming generators cannot make mazes with missing cells\n");
+        return -1;
+    }
+    MazeRows rows;
+    rows.maze = maze;
+    rows.next_row = 0;
+    return generator(maze->width, (uint64_t) maze->height, context, maze_row_sink, &rows);
+}
+
+#endif //MAZE_ROWSTREAM_H
@@ -3,13 +3,31 @@
 
 #include <SDL2/SDL.h>
 #include "Maze.h"
+#include "GeneratorContext.h"
+#include "generator/Tiled.h"
+#include "solver/Diameter.h"
 
 void render_maze_to_sdl(SDL_Renderer *renderer, const Maze *maze, int cell_size);
 
+/**
+ * Generate and show a maze, generating a new one each time a key is pressed.
+ * @param maze The maze to generate
+ * @param cell_size The size of each cell in pixels
+ * @param maze_generator The generator to use
+ * @param seed The seed for the first maze, later ones get seeds from it
+ * @param tile_size Generate the maze in tiles of this size at the same time,
+ * or 0 to generate it whole
+ * @param diameter_flags What to do with the longest path of each maze, see
+ * report_maze_diameter, or 0 to not find it
+ * @return 0 if successful
+ */
 int render_maze_with_refresh(
         const Maze *maze,
         int cell_size,
-        void (*maze_generator)(const Maze *)
+        void (*maze_generator)(const Maze *, GeneratorContext *),
+        uint64_t seed,
+        int tile_size,
+        int diameter_flags
 ) {
     if (maze == NULL || cell_size < 1 || maze_generator == NULL) {
         fprintf(stderr, "Invalid arguments for rendering");
@@ -44,7 +62,14 @@ int render_maze_with_refresh(
         return 1;
     }
 
-    maze_generator(maze);
+    // reused for every regeneration so only the first one allocates
+    GeneratorContext *context = new_generator_context(seed);
+    DiameterSolver *solver = diameter_flags != 0 ? new_diameter_solver() : NULL;
+    Random seeds;
+    seed_random(&seeds, seed);
+    printf("Seed: %llu\n", (unsigned long long) seed);
+    generate_maze_with_seed_in_tiles(maze, context, maze_generator, seed, tile_size);
+    if (diameter_flags != 0) report_maze_diameter(solver, maze, diameter_flags, context->thread_count, "Maze");
 
     render_maze_to_sdl(renderer, maze, cell_size);
     bool done = false;
@@ -73,7 +98,12 @@ int render_maze_with_refresh(
                 if (code == SDLK_ESCAPE) {
                     done = true;
                 } else {
-                    maze_generator(maze);
+                    seed = next_random(&seeds);
+                    printf("Seed: %llu\n", (unsigned long long) seed);
+                    generate_maze_with_seed_in_tiles(maze, context, maze_generator, seed, tile_size);
+                    if (diameter_flags != 0) {
+                        report_maze_diameter(solver, maze, diameter_flags, context->thread_count, "Maze");
+                    }
                     render_maze_to_sdl(renderer, maze, cell_size);
                 }
                 break;
@@ -82,6 +112,8 @@ int render_maze_with_refresh(
     }
 
 
+    delete_diameter_solver(solver);
+    delete_generator_context(context);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     return 0;
@@ -100,10 +132,10 @@ void render_maze_to_sdl(SDL_Renderer *renderer, const Maze *maze, int cell_size)
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
 
     for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            Cell *cell = cell_at(maze, x, y);
-            if (cell == NULL) continue;
-            Directions dirs = get_blocked_directions(cell);
+        size_t index = index_at(maze, 0, y);
+        for (int x = 0; x < width; x++, index = get_index_adjacent(maze, index, EAST)) {
+            if (!index_in_maze(maze, index)) continue;
+            Directions dirs = directions_from_walls(~get_open_walls(maze, index));
             if (dirs.north) {
                 SDL_RenderDrawLine(
                         renderer,
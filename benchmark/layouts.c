@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <time.h>
+#include "../Maze.h"
+#include "../generator/HuntKill.h"
+#include "../generator/Backtracker.h"
+#include "../generator/Prim.h"
+#include "../generator/Kruskal.h"
+#include "../solver/DistanceField.h"
+
+/**
+ * Times generating and solving the same mazes with each grid layout.
+ *
+ * The mazes are the same whatever the layout, so any difference in time is
+ * down to how the grid sits in memory. Run it under
+ * perf stat -e cache-references,cache-misses to see the miss rates as well.
+ */
+
+double seconds_now() {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    long size = argc >= 2 ? strtol(argv[1], NULL, 10) : 8192;
+    if (size < 1 || size > MAX_MAZE_DIMENSION) {
+        fprintf(stderr, "size must be between 1 and %d\n", MAX_MAZE_DIMENSION);
+        return EXIT_FAILURE;
+    }
+    const char *layout_names[] = {"row", "tiled"};
+    const enum MazeLayout layouts[] = {LAYOUT_ROW_MAJOR, LAYOUT_TILED};
+    const char *generator_names[] = {"huntkill", "backtracker", "prim", "kruskal"};
+    void (*generators[])(const Maze *, GeneratorContext *) = {
+            generate_hunt_and_kill_maze, generate_backtracker_maze, generate_prim_maze, generate_kruskal_maze
+    };
+
+    printf("%ldx%ld, one thread\n", size, size);
+    printf("%-12s %-6s %10s %10s\n", "generator", "layout", "generate", "bfs");
+    for (size_t g = 0; g < sizeof(generators) / sizeof(generators[0]); g++) {
+        for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+            Maze *maze = new_maze_with_layout((int) size, (int) size, false, layouts[l]);
+            GeneratorContext *context = new_generator_context(0);
+            context->thread_count = 1;
+            DistanceField *field = new_distance_field();
+
+            double started = seconds_now();
+            generate_maze_with_seed(maze, context, generators[g], 1);
+            double generated = seconds_now();
+            compute_distance_field(field, maze, index_at(maze, 0, 0));
+            double solved = seconds_now();
+
+            printf("%-12s %-6s %9.3fs %9.3fs\n", generator_names[g], layout_names[l],
+                   generated - started, solved - generated);
+            delete_distance_field(field);
+            delete_generator_context(context);
+            delete_maze(maze);
+        }
+    }
+    return 0;
+}
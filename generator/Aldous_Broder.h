@@ -2,43 +2,71 @@
 #define MAZE_ALDOUS_BRODER_H
 
 #include "../Maze.h"
+#include "../GeneratorContext.h"
 #include "../utils.h"
 
-void generate_aldous_broder_maze(const Maze *maze) {
+void aldous_broder_walk(const Maze *maze, GeneratorContext *context, size_t start, size_t cells);
+
+/**
+ * Generate a maze using the Aldous-Broder algorithm.
+ *
+ * A random walk links every cell it reaches for the first time. Mazes with
+ * cells missing can be split into parts that cannot reach each other, each
+ * of these is walked on it's own so the walk always has somewhere left to go.
+ * @param maze The maze
+ * @param context The generator context
+ */
+void generate_aldous_broder_maze(const Maze *maze, GeneratorContext *context) {
     if (maze == NULL) {
         fprintf(stderr, "No maze given to generator");
         exit(EXIT_FAILURE);
     }
-    const int width = maze->width, height = maze->height;
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator");
+        exit(EXIT_FAILURE);
+    }
     unlink_all_cells(maze);
+    if (maze->cell_count == 0) return;
 
-    Cell *visited[height][width];
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            visited[y][x] = NULL;
-        }
+    reset_visited(context, maze);
+
+    size_t current = random_index(maze, &context->random);
+    if (maze->cell_count == (size_t) maze->width * maze->height) {
+        aldous_broder_walk(maze, context, current, maze->cell_count);
+        return;
     }
 
-    Cell *current = random_cell(maze);
-    if (current == NULL) {
-        fprintf(stderr, "Unable to start at random cell");
-        exit(EXIT_FAILURE);
+    unsigned char *directions = reserve_directions(context, maze);
+    memset(directions, PART_UNSEEN, maze->grid_size);
+    aldous_broder_walk(maze, context, current, flood_maze_part(maze, context, current));
+    for (int y = 0; y < maze->height; y++) {
+        size_t index = index_at(maze, 0, y);
+        for (int x = 0; x < maze->width; x++, index = get_index_adjacent(maze, index, EAST)) {
+            if (index_in_maze(maze, index) && directions[index] == PART_UNSEEN) {
+                aldous_broder_walk(maze, context, index, flood_maze_part(maze, context, index));
+            }
+        }
     }
+}
 
-    int visited_count = 1;
-    visited[current->y][current->x] = current;
+/**
+ * Walk randomly from start until a given number of cells have been visited.
+ * @param maze The maze
+ * @param context The generator context
+ * @param start The grid index to start from
+ * @param cells The number of cells start can reach, including itself
+ */
+void aldous_broder_walk(const Maze *maze, GeneratorContext *context, size_t start, size_t cells) {
+    size_t current = start;
+    size_t visited_count = 1;
+    set_visited(context, current);
 
-    int all_cells_count = maze->cell_count;
-    while (visited_count < all_cells_count) {
-        Cell *adjacent = NULL;
-        int dir;
-        while (adjacent == NULL) {
-            dir = random_direction();
-            adjacent = get_cell_adjacent(maze, current, dir);
-        }
-        if (visited[adjacent->y][adjacent->x] == NULL) {
-            link_cell_in_dir(maze, current, dir);
-            visited[adjacent->y][adjacent->x] = adjacent;
+    while (visited_count < cells) {
+        int dir = random_direction_in(get_neighbour_mask(maze, current), &context->random);
+        size_t adjacent = get_index_adjacent(maze, current, dir);
+        if (!is_visited(context, adjacent)) {
+            link_index_in_dir(maze, current, dir);
+            set_visited(context, adjacent);
             visited_count ++;
         }
         current = adjacent;
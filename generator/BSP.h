@@ -1,303 +1,260 @@
 #ifndef MAZE_BSP_H
 #define MAZE_BSP_H
 
-#include <math.h>
 #include "../utils.h"
 #include "../Maze.h"
+#include "../GeneratorContext.h"
 
-typedef struct bsp_segment {
-    int start_x;
-    int start_y;
-    int end_x;
-    int end_y;
-    struct bsp_segment *parent;
-    struct bsp_segment *child1;
-    struct bsp_segment *child2;
-} BSP_Segment;
+// segments with more cells than this are split before the threads start,
+// the rest are each finished on one thread
+#define BSP_PARALLEL_CELLS ((size_t) 1 << 16)
 
-BSP_Segment *new_bsp_segment(int start_x, int start_y, int end_x, int end_y);
+// cells opened at once when opening up a whole row
+#define BSP_ROW_CHUNK 256
 
-void delete_bsp_segment_and_children(BSP_Segment *segment);
+// Splitting the smaller half first means each segment waiting on the stack
+// has at most half the cells of the one below it, so this is always enough
+#define BSP_STACK_SIZE (sizeof(size_t) * CHAR_BIT + 1)
 
-void delete_bsp_segment(BSP_Segment *segment);
+typedef MazeSegment BSP_Segment;
 
-void generate_BSP_maze(Maze const *maze);
+typedef struct {
+    const Maze *maze;
+    const BSP_Segment *segments;
+    uint64_t seed;
+} BSP_Tasks;
 
-void bsp_split(BSP_Segment *source, Maze const *maze);
+void generate_BSP_maze(Maze const *maze, GeneratorContext *context);
 
-void bsp_split_horizontal(BSP_Segment *source, Maze const *maze);
+void bsp_divide(Maze const *maze, BSP_Segment root, Random *random, GeneratorContext *context);
 
-void bsp_split_vertical(BSP_Segment *source, Maze const *maze);
+bool bsp_split(Maze const *maze, BSP_Segment source, BSP_Segment *first, BSP_Segment *second, Random *random);
 
-void bsp_split_recursive(BSP_Segment *parent, Maze const *maze);
+int bsp_pick_passage(Maze const *maze, size_t start, int along, int through, int length, int preferred, Random *random);
 
+void bsp_segments_task(void *data, size_t start, size_t end);
 
-void generate_BSP_maze(Maze const *maze) {
+void bsp_open_rows_task(void *data, size_t start, size_t end);
+
+void generate_BSP_maze(Maze const *maze, GeneratorContext *context) {
     // BSP = Binary Space Partition
     if (maze == NULL) {
         fprintf(stderr, "No maze given to generator");
         exit(EXIT_FAILURE);
     }
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator");
+        exit(EXIT_FAILURE);
+    }
 
     const int width = maze->width;
     const int height = maze->height;
-    const int total_cells = maze->cell_count;
 
-    if (total_cells != width * height) {
-        fprintf(stderr, "BSP generation only works on full grids");
-        exit(EXIT_FAILURE);
+    if (maze->cell_count == (size_t) width * height) {
+        run_parallel(context->thread_count, (size_t) height, bsp_open_rows_task, (void *) maze);
+    } else {
+        link_all_adjacent_cells(maze);
     }
 
-    link_all_adjacent_cells(maze);
-
     // We will be splitting the grid and essentially connecting the 2 halves
-    // each time until we finish
-
-    BSP_Segment *starting_segment = new_bsp_segment(0, 0, width, height);
-    bsp_split_recursive(starting_segment, maze);
+    // each time until we finish. Big segments are split here and the smaller
+    // ones they end up as are collected in context->segments.
+    BSP_Segment root = {0, 0, width, height};
+    context->segment_count = 0;
+    bsp_divide(maze, root, &context->random, context);
+
+    // Segments never share cells so they can be split at the same time, each
+    // with it's own random stream
+    BSP_Tasks tasks;
+    tasks.maze = maze;
+    tasks.segments = context->segments;
+    tasks.seed = next_random(&context->random);
+    run_parallel(context->thread_count, context->segment_count, bsp_segments_task, &tasks);
+
+    // missing cells can cut a corridor in two or leave a wall with nowhere
+    // for a passage
+    if (maze->cell_count != (size_t) width * height) {
+        connect_maze_parts(maze, context);
+    }
 }
 
-BSP_Segment *new_bsp_segment(int start_x, int start_y, int end_x, int end_y) {
-    BSP_Segment *segment = malloc(sizeof(BSP_Segment));
-    if (segment == NULL) {
-        fprintf(stderr, "Unable to allocate BSP Segment");
-        exit(EXIT_FAILURE);
+void bsp_segments_task(void *data, size_t start, size_t end) {
+    const BSP_Tasks *tasks = data;
+    for (size_t i = start; i < end; i++) {
+        Random random;
+        seed_random_stream(&random, tasks->seed, i);
+        bsp_divide(tasks->maze, tasks->segments[i], &random, NULL);
     }
-    segment->start_x = start_x;
-    segment->start_y = start_y;
-    segment->end_x = end_x;
-    segment->end_y = end_y;
-    segment->parent = NULL;
-    segment->child1 = NULL;
-    segment->child2 = NULL;
-    return segment;
 }
 
-void delete_bsp_segment_and_children(BSP_Segment *segment) {
-    if (segment == NULL) return;
-    delete_bsp_segment_and_children(segment->child1);
-    delete_bsp_segment_and_children(segment->child2);
-    BSP_Segment *parent = segment->parent;
-    if (parent != NULL) {
-        if (parent->child1 == segment) {
-            parent->child1 = NULL;
-        }
-        if (parent->child2 == segment) {
-            parent->child2 = NULL;
+/**
+ * Link every cell in some rows to all of their neighbours, for mazes with no
+ * cells missing. Each row only writes it's own cells.
+ */
+void bsp_open_rows_task(void *data, size_t start, size_t end) {
+    const Maze *maze = data;
+    const int width = maze->width;
+    const int height = maze->height;
+    unsigned char cells[BSP_ROW_CHUNK];
+    for (size_t row = start; row < end; row++) {
+        const int y = (int) row;
+        unsigned int vertical = 0;
+        if (y > 0) vertical |= DIRECTION_BIT(NORTH);
+        if (y < height - 1) vertical |= DIRECTION_BIT(SOUTH);
+        for (int x = 0; x < width; x += BSP_ROW_CHUNK) {
+            size_t count = (size_t) (width - x) < BSP_ROW_CHUNK ? (size_t) (width - x) : BSP_ROW_CHUNK;
+            memset(cells, (int) (vertical | DIRECTION_BIT(EAST) | DIRECTION_BIT(WEST)), count);
+            if (x == 0) cells[0] &= ~DIRECTION_BIT(WEST);
+            if ((size_t) (width - x) == count) cells[count - 1] &= ~DIRECTION_BIT(EAST);
+            write_row_cells(maze, x, y, cells, count);
         }
-        segment->parent = NULL;
     }
-    free(segment);
-    segment = NULL;
 }
 
-void delete_bsp_segment(BSP_Segment *segment) {
-    if (segment == NULL) return;
-    BSP_Segment *parent = segment->parent;
-    BSP_Segment *child1 = segment->child1;
-    BSP_Segment *child2 = segment->child2;
-
-    if (parent != NULL) {
-        if (parent->child1 == segment) {
-            parent->child1 = NULL;
+/**
+ * Keep splitting a segment and all the segments it is split into until they
+ * are one cell wide or high.
+ *
+ * The work is kept on a fixed size stack rather than recursing, so long thin
+ * mazes do not run out of stack.
+ * @param maze The maze
+ * @param root The segment to start with
+ * @param random The random state to split with
+ * @param context If not NULL segments with no more than BSP_PARALLEL_CELLS
+ * cells are added to context->segments instead of being split
+ */
+void bsp_divide(Maze const *maze, BSP_Segment root, Random *random, GeneratorContext *context) {
+    BSP_Segment stack[BSP_STACK_SIZE];
+    size_t count = 0;
+    stack[count++] = root;
+    while (count > 0) {
+        BSP_Segment segment = stack[--count];
+        if (context != NULL && segment_cells(segment) <= BSP_PARALLEL_CELLS) {
+            push_segment(context, segment);
+            continue;
         }
-        if (parent->child2 == segment) {
-            parent->child2 = NULL;
+        BSP_Segment first, second;
+        if (!bsp_split(maze, segment, &first, &second, random)) continue;
+        if (segment_cells(first) < segment_cells(second)) {
+            stack[count++] = second;
+            stack[count++] = first;
+        } else {
+            stack[count++] = first;
+            stack[count++] = second;
         }
-        segment->parent = NULL;
     }
-    if (child1 != NULL) {
-        segment->child1 = NULL;
-        child1->parent = NULL;
-    }
-    if (child2 != NULL) {
-        segment->child2 = NULL;
-        child2->parent = NULL;
-    }
-    free(segment);
-    segment = NULL;
 }
 
-void bsp_split(BSP_Segment *source, Maze const *maze) {
-    if (source == NULL || maze == NULL) return;
-    if (source->child1 != NULL || source->child2 != NULL) {
-        fprintf(stderr, "Cannot split an already split segment");
-        return;
+/**
+ * Split a segment in two with a wall that has a single passage through it.
+ * @param maze The maze
+ * @param source The segment to split
+ * @param first Filled with the top or left part
+ * @param second Filled with the bottom or right part
+ * @param random The random state to split with
+ * @return false if the segment is only one cell wide or high so cannot be
+ * split
+ */
+bool bsp_split(Maze const *maze, BSP_Segment source, BSP_Segment *first, BSP_Segment *second, Random *random) {
+    int range_x = source.end_x - source.start_x;
+    int range_y = source.end_y - source.start_y;
+    if (range_x <= 1 || range_y <= 1) return false;
+
+    bool horizontal;
+    if (range_y > range_x) {
+        horizontal = true;
+    } else if (range_x > range_y) {
+        horizontal = false;
+    } else {
+        // randomly choose dimension to split in
+        horizontal = !coin_flip(random);
     }
 
-    int range_x = source->end_x - source->start_x;
-    int range_y = source->end_y - source->start_y;
-
-    // find a pivot within the segment
-
-    // make sure this isn't a single cell
-    if (range_x != 0 || range_y != 0) {
-        if (range_x == 0) {
-            // cannot split vertically anymore
-            bsp_split_horizontal(source, maze);
-        } else if (range_y == 0) {
-            // cannot split horizontally anymore
-            bsp_split_vertical(source, maze);
-        } else if (range_y > range_x) {
-            bsp_split_horizontal(source, maze);
-        } else if (range_x > range_y) {
-            bsp_split_vertical(source, maze);
-        } else {
-            // randomly choose dimension to split in
-            if (coin_flip()) {
-                bsp_split_vertical(source, maze);
-            } else {
-                bsp_split_horizontal(source, maze);
+    *first = source;
+    *second = source;
+    if (horizontal) {
+        // ##########
+        // #        #
+        // #---.----#
+        // #        #
+        // ##########
+        int pivot_y = source.start_y + (int) random_below(random, range_y - 1);
+        int passage_x = (int) random_below(random, range_x);
+        size_t index = index_at(maze, source.start_x, pivot_y);
+        passage_x = source.start_x + bsp_pick_passage(
+                maze, index, EAST, SOUTH, range_x, passage_x, random
+        );
+        for (int x = source.start_x; x < source.end_x; x++, index = get_index_adjacent(maze, index, EAST)) {
+            if (x != passage_x) {
+                unlink_index_in_dir(maze, index, SOUTH);
             }
         }
-
-    }
-
-}
-
-void bsp_split_horizontal(BSP_Segment *source, Maze const *maze) {
-    int range_y = source->end_y - source->start_y;
-    int range_x = source->end_x - source->start_x;
-    int pivot_y;
-    int passage_x;
-    if (range_y == 0) {
-        pivot_y = range_y + source->start_y;
-    } else {
-        pivot_y = (rand() % range_y) + source->start_y;
-    }
-    if (range_x == 0) {
-        passage_x = range_x + source->start_x;
+        first->end_y = pivot_y + 1;
+        second->start_y = pivot_y + 1;
     } else {
-        passage_x = (rand() % range_x) + source->start_x;
-    }
-    // ##########
-    // #        #
-    // x        #
-    // #        #
-    // ##########
-
-    // Add a wall
-    // ##########
-    // #        #
-    // #--------#
-    // #        #
-    // ##########
-
-    // Add a gap to the wall
-    // ##########
-    // #        #
-    // #---.----#
-    // #        #
-    // ##########
-
-    for (int x = source->start_x; x < source->end_x; x++) {
-        Cell *cell = cell_at(maze, x, pivot_y);
-        if (cell == NULL) continue;
-        if (x != passage_x) {
-            unlink_cell_in_dir(cell, SOUTH);
-        } else {
-            //link_cell_in_dir(maze, cell, SOUTH);
+        // ##########
+        // #    |   #
+        // #    .   #
+        // #    |   #
+        // ##########
+        int pivot_x = source.start_x + (int) random_below(random, range_x - 1);
+        int passage_y = (int) random_below(random, range_y);
+        size_t index = index_at(maze, pivot_x, source.start_y);
+        passage_y = source.start_y + bsp_pick_passage(
+                maze, index, SOUTH, EAST, range_y, passage_y, random
+        );
+        for (int y = source.start_y; y < source.end_y; y++, index = get_index_adjacent(maze, index, SOUTH)) {
+            if (y != passage_y) {
+                unlink_index_in_dir(maze, index, EAST);
+            }
         }
+        first->end_x = pivot_x + 1;
+        second->start_x = pivot_x + 1;
     }
-
-    // return the 2 new sub-segments
-    source->child1 = new_bsp_segment(
-            source->start_x,
-            source->start_y,
-            source->end_x,
-            pivot_y
-    );
-    source->child1->parent = source;
-
-    source->child2 = new_bsp_segment(
-            source->start_x,
-            pivot_y + 1,
-            source->end_x,
-            source->end_y
-    );
-    source->child2->parent = source;
-
+    return true;
 }
 
-void bsp_split_vertical(BSP_Segment *source, Maze const *maze) {
-    int range_y = source->end_y - source->start_y;
-    int range_x = source->end_x - source->start_x;
-    int pivot_x;
-    int passage_y;
-    if (range_x == 0) {
-        pivot_x = range_x + source->start_x;
-    } else {
-        pivot_x = (rand() % range_x) + source->start_x;
-    }
-    if (range_y == 0) {
-        passage_y = range_y + source->start_y;
-    } else {
-        passage_y = (rand() % range_y) + source->start_y;
+/**
+ * Pick where along a wall to leave a passage.
+ *
+ * The preferred position is used if the cells either side of it are both in
+ * the maze, otherwise a random position where they are is picked.
+ * @param maze The maze
+ * @param start The grid index of the first cell along the wall
+ * @param along The direction the wall runs in
+ * @param through The direction a passage goes through the wall
+ * @param length The number of cells along the wall
+ * @param preferred The preferred offset along the wall
+ * @param random The random state used when the preferred offset is not valid
+ * @return The offset along the wall or -1 if there is nowhere to put one
+ */
+int bsp_pick_passage(
+        Maze const *maze,
+        size_t start,
+        int along,
+        int through,
+        int length,
+        int preferred,
+        Random *random
+) {
+    size_t index = start;
+    int valid = 0;
+    for (int i = 0; i < length; i++, index = get_index_adjacent(maze, index, along)) {
+        if (index_in_maze(maze, index) && index_in_maze(maze, get_index_adjacent(maze, index, through))) {
+            if (i == preferred) return preferred;
+            valid++;
+        }
     }
+    if (valid == 0) return -1;
 
-    // #####x####
-    // #        #
-    // #        #
-    // #        #
-    // ##########
-
-    // Add a wall
-    // ##########
-    // #    |   #
-    // #    |   #
-    // #    |   #
-    // ##########
-
-    // Add a gap to the wall
-    // ##########
-    // #    |   #
-    // #    .   #
-    // #    |   #
-    // ##########
-
-    for (int y = source->start_y; y < source->end_y; y++) {
-        Cell *cell = cell_at(maze, pivot_x, y);
-        if (cell == NULL) continue;
-        if (y != passage_y) {
-            unlink_cell_in_dir(cell, EAST);
-        } else {
-            //link_cell_in_dir(maze, cell, EAST);
+    int pick = (int) random_below(random, valid);
+    index = start;
+    for (int i = 0; i < length; i++, index = get_index_adjacent(maze, index, along)) {
+        if (index_in_maze(maze, index) && index_in_maze(maze, get_index_adjacent(maze, index, through))) {
+            if (pick-- == 0) return i;
         }
     }
-
-    // return the 2 new sub-segments
-    source->child1 = new_bsp_segment(
-            source->start_x,
-            source->start_y,
-            pivot_x,
-            source->end_y
-    );
-    source->child1->parent = source;
-
-    source->child2 = new_bsp_segment(
-            pivot_x + 1,
-            source->start_y,
-            source->end_x,
-            source->end_y
-    );
-    source->child2->parent = source;
-}
-
-void bsp_split_recursive(
-        BSP_Segment *parent,
-        Maze const *maze
-) {
-    if (parent == NULL || maze == NULL) return;
-
-    bsp_split(parent, maze);
-    BSP_Segment *child1 = parent->child1;
-    BSP_Segment *child2 = parent->child2;
-
-    // delete as we go to reduce memory usage
-    delete_bsp_segment(parent);
-
-    bsp_split_recursive(child1, maze);
-    bsp_split_recursive(child2, maze);
+    return -1;
 }
 
 #endif //MAZE_BSP_H
@@ -0,0 +1,104 @@
+#ifndef MAZE_BACKTRACKER_H
+#define MAZE_BACKTRACKER_H
+
+#include "../Maze.h"
+#include "../GeneratorContext.h"
+#include "../utils.h"
+
+// directions packed into each byte of the path
+#define BACKTRACKER_STEPS_PER_BYTE 4
+
+void backtracker_push(unsigned char *path, size_t depth, int dir);
+
+int backtracker_peek(const unsigned char *path, size_t depth);
+
+/**
+ * Generate a maze using the Recursive Backtracker algorithm.
+ *
+ * A random walk that never visits a cell twice, when it gets stuck it goes
+ * back along it's path to the last cell with an unvisited neighbour. Rather
+ * than recursing or keeping every cell on the path, only the direction of
+ * each step is kept, 2 bits each, and the way back is worked out from it.
+ * With the visited bitset that is under half a byte per cell, so a 10k x 10k
+ * maze needs less than 40MB on top of the maze.
+ *
+ * Parts of a masked maze it cannot reach are started again from
+ * next_unvisited_index.
+ * @param maze The maze
+ * @param context The generator context
+ */
+void generate_backtracker_maze(const Maze *maze, GeneratorContext *context) {
+    if (maze == NULL) {
+        fprintf(stderr, "No maze given to generator");
+        exit(EXIT_FAILURE);
+    }
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator");
+        exit(EXIT_FAILURE);
+    }
+    const size_t total_cells = maze->cell_count;
+    unlink_all_cells(maze);
+    if (total_cells == 0) return;
+
+    reset_visited(context, maze);
+    // the path can never be longer than the cells in the maze
+    size_t path_bytes = total_cells / BACKTRACKER_STEPS_PER_BYTE + 1;
+    unsigned char *path = reserve_generator_buffer(
+            context->directions, &context->direction_capacity, path_bytes, sizeof(unsigned char)
+    );
+    context->directions = path;
+
+    size_t current = random_index(maze, &context->random);
+    set_visited(context, current);
+    size_t visited_count = 1;
+    size_t depth = 0;
+    // where next_unvisited_index looks for a part not reached yet
+    size_t restart_cursor = 0;
+
+    while (visited_count < total_cells) {
+        unsigned int possible = unvisited_directions(context, maze, current);
+
+        if (possible != 0) {
+            int dir = random_direction_in(possible, &context->random);
+            link_index_in_dir(maze, current, dir);
+            current = get_index_adjacent(maze, current, dir);
+            set_visited(context, current);
+            visited_count++;
+            backtracker_push(path, depth++, dir);
+        } else if (depth > 0) {
+            // step back the way we came
+            int dir = backtracker_peek(path, --depth);
+            current = get_index_adjacent(maze, current, opposite_direction(dir));
+        } else {
+            // nothing left to reach from here, start again somewhere new
+            current = next_unvisited_index(context, maze, &restart_cursor);
+            set_visited(context, current);
+            visited_count++;
+        }
+    }
+}
+
+/**
+ * Store the direction of a step along the path.
+ * @param path The packed path
+ * @param depth The step number
+ * @param dir The direction
+ */
+void backtracker_push(unsigned char *path, size_t depth, int dir) {
+    unsigned int shift = (unsigned int) (depth % BACKTRACKER_STEPS_PER_BYTE) * 2u;
+    unsigned char *byte = path + depth / BACKTRACKER_STEPS_PER_BYTE;
+    *byte = (unsigned char) ((*byte & ~(3u << shift)) | ((unsigned int) dir << shift));
+}
+
+/**
+ * Get the direction of a step along the path.
+ * @param path The packed path
+ * @param depth The step number
+ * @return The direction
+ */
+int backtracker_peek(const unsigned char *path, size_t depth) {
+    unsigned int shift = (unsigned int) (depth % BACKTRACKER_STEPS_PER_BYTE) * 2u;
+    return (int) ((path[depth / BACKTRACKER_STEPS_PER_BYTE] >> shift) & 3u);
+}
+
+#endif //MAZE_BACKTRACKER_H
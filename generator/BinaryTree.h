@@ -3,48 +3,194 @@
 
 #include "../utils.h"
 #include "../Maze.h"
+#include "../GeneratorContext.h"
 
-void generate_binary_tree_maze(const Maze *maze) {
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// cells worked on at once, one random bit each
+#define BINARY_TREE_CHUNK 64
+
+typedef struct {
+    const Maze *maze;
+    uint64_t seed;
+} BinaryTreeRows;
+
+void generate_masked_binary_tree_maze(const Maze *maze, GeneratorContext *context);
+
+void binary_tree_rows_task(void *data, size_t start, size_t end);
+
+uint64_t binary_tree_east_bits(const Maze *maze, int x, int y, size_t count, Random *random);
+
+void binary_tree_pack_cells(
+        unsigned char *cells, size_t count,
+        uint64_t north, uint64_t east, uint64_t south, uint64_t west
+);
+
+/**
+ * Generate a maze using the Binary Tree algorithm.
+ *
+ * Every cell links either north or east. Each choice is one random bit so
+ * 64 cells are decided with one random number and written straight into the
+ * grid, a row at a time. Rows are shared out between threads and each has
+ * it's own random stream, so the maze for a seed does not depend on the
+ * thread count or layout.
+ * @param maze The maze
+ * @param context The generator context
+ */
+void generate_binary_tree_maze(const Maze *maze, GeneratorContext *context) {
     if (maze == NULL) {
         fprintf(stderr, "No maze given to generator");
         exit(EXIT_FAILURE);
     }
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator");
+        exit(EXIT_FAILURE);
+    }
+    if (maze->cell_count != (size_t) maze->width * maze->height) {
+        generate_masked_binary_tree_maze(maze, context);
+        return;
+    }
+
+    // every cell is written whole so there is no need to unlink first
+    BinaryTreeRows rows;
+    rows.maze = maze;
+    rows.seed = next_random(&context->random);
+    run_parallel(context->thread_count, (size_t) maze->height, binary_tree_rows_task, &rows);
+}
+
+void binary_tree_rows_task(void *data, size_t start, size_t end) {
+    const BinaryTreeRows *rows = data;
+    const Maze *maze = rows->maze;
+    const int width = maze->width;
+    const int height = maze->height;
+    unsigned char cells[BINARY_TREE_CHUNK];
+
+    for (size_t row = start; row < end; row++) {
+        const int y = (int) row;
+        // the south walls come from the choices of the row below, so work
+        // them out again from it's stream rather than reading it's cells
+        Random random_cells, random_south;
+        seed_random_stream(&random_cells, rows->seed, (uint64_t) y);
+        seed_random_stream(&random_south, rows->seed, (uint64_t) y + 1);
+        uint64_t west_carry = 0;
+        for (int x = 0; x < width; x += BINARY_TREE_CHUNK) {
+            size_t count = (size_t) (width - x) < BINARY_TREE_CHUNK ? (size_t) (width - x) : BINARY_TREE_CHUNK;
+            uint64_t used = count == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << count) - 1;
+
+            uint64_t east = binary_tree_east_bits(maze, x, y, count, &random_cells);
+            uint64_t north = y == 0 ? 0 : ~east & used;
+            uint64_t south = 0;
+            if (y + 1 < height) {
+                south = ~binary_tree_east_bits(maze, x, y + 1, count, &random_south) & used;
+            }
+            uint64_t west = (east << 1u) | west_carry;
+            west_carry = east >> (count - 1);
+
+            binary_tree_pack_cells(cells, count, north, east, south, west & used);
+            write_row_cells(maze, x, y, cells, count);
+        }
+    }
+}
+
+/**
+ * Decide which cells in part of a row link east, the rest link north.
+ * @param maze The maze
+ * @param x The first cell
+ * @param y The row
+ * @param count The number of cells, no more than 64
+ * @param random The random stream of the row
+ * @return A bit per cell, set when the cell links east
+ */
+uint64_t binary_tree_east_bits(const Maze *maze, int x, int y, size_t count, Random *random) {
+    uint64_t east;
+    if (y == 0) {
+        // the top row can only go east
+        east = ~(uint64_t) 0;
+    } else {
+        east = next_random(random);
+    }
+    // the last column can only go north, or nowhere in the top right
+    if ((size_t) (maze->width - x) <= count) {
+        east &= ~((uint64_t) 1 << (count - 1));
+    }
+    return east;
+}
+
+/**
+ * Turn a bit per cell for each direction into packed cells.
+ * @param cells Filled with the packed cells
+ * @param count The number of cells
+ * @param north Cells open to the north
+ * @param east Cells open to the east
+ * @param south Cells open to the south
+ * @param west Cells open to the west
+ */
+void binary_tree_pack_cells(
+        unsigned char *cells, size_t count,
+        uint64_t north, uint64_t east, uint64_t south, uint64_t west
+) {
+    size_t i = 0;
+#if defined(__BMI2__)
+    // spread 8 bits into the same bit of 8 bytes at once
+    const uint64_t lowest = 0x0101010101010101u;
+    for (; i + 8 <= count; i += 8) {
+        uint64_t packed = _pdep_u64((north >> i) & 0xFFu, lowest << NORTH)
+                          | _pdep_u64((east >> i) & 0xFFu, lowest << EAST)
+                          | _pdep_u64((south >> i) & 0xFFu, lowest << SOUTH)
+                          | _pdep_u64((west >> i) & 0xFFu, lowest << WEST);
+        // x86 is little endian so byte 0 is the first cell
+        memcpy(cells + i, &packed, sizeof(packed));
+    }
+#endif
+    for (; i < count; i++) {
+        cells[i] = (unsigned char) ((((north >> i) & 1u) << NORTH)
+                                    | (((east >> i) & 1u) << EAST)
+                                    | (((south >> i) & 1u) << SOUTH)
+                                    | (((west >> i) & 1u) << WEST));
+    }
+}
+
+/**
+ * Binary Tree for mazes with cells missing, where a cell can only link to
+ * neighbours that are in the maze. Cells that cannot link north or east
+ * leave separate trees that are joined up afterwards.
+ * @param maze The maze
+ * @param context The generator context
+ */
+void generate_masked_binary_tree_maze(const Maze *maze, GeneratorContext *context) {
     const int width = maze->width, height = maze->height;
     unlink_all_cells(maze);
 
     for (int y = height - 1; y >= 0; y--) {
-        for (int x = 0; x < width; x++) {
-            Cell *cell = cell_at(maze, x, y);
-            Directions dirs = get_blocked_directions(cell);
+        size_t index = index_at(maze, 0, y);
+        for (int x = 0; x < width; x++, index = get_index_adjacent(maze, index, EAST)) {
+            if (!index_in_maze(maze, index)) continue;
+            // the last column and top row only have one choice, as do cells
+            // next to ones missing from the maze
+            bool north = index_in_maze(maze, get_index_adjacent(maze, index, NORTH));
+            bool east = index_in_maze(maze, get_index_adjacent(maze, index, EAST));
             int link_dir;
-            if (x == width - 1) {
+            if (north && east) {
+                bool should_east = coin_flip(&context->random);
+                if (should_east) {
+                    link_dir = EAST;
+                } else {
+                    link_dir = NORTH;
+                }
+            } else if (north) {
                 link_dir = NORTH;
-            } else if (y == 0) {
+            } else if (east) {
                 link_dir = EAST;
             } else {
-                if (dirs.north && dirs.east) {
-                    bool should_east = coin_flip();
-                    if (should_east) {
-                        link_dir = EAST;
-                    } else {
-                        link_dir = NORTH;
-                    }
-                } else {
-                    if (dirs.north) {
-                        link_dir = NORTH;
-                    } else if (dirs.east) {
-                        link_dir = EAST;
-                    } else {
-                        link_dir = -1;
-                    }
-                }
-            }
-            if (link_dir != -1) {
-                link_cell_in_dir(maze, cell, link_dir);
+                continue;
             }
+            link_index_in_dir(maze, index, link_dir);
         }
     }
-
+    // cells with no cell to the north or east end trees of their own
+    connect_maze_parts(maze, context);
 }
 
 
@@ -0,0 +1,199 @@
+#ifndef MAZE_ELLER_H
+#define MAZE_ELLER_H
+
+#include "../Maze.h"
+#include "../GeneratorContext.h"
+#include "../RowStream.h"
+#include "../utils.h"
+
+// next_set entry of a set that has not linked down yet
+#define ELLER_NO_SET SIZE_MAX
+
+size_t eller_find_set(size_t *parents, size_t set);
+
+int stream_masked_eller_maze(
+        int width, uint64_t height, const Maze *mask,
+        GeneratorContext *context, MazeRowSink sink, void *data
+);
+
+/**
+ * Generate a maze a row at a time using Eller's algorithm.
+ *
+ * Each cell in a row is labelled with the set of cells it is connected to so
+ * far. Neighbouring cells in different sets are randomly joined, then every
+ * set links down at least once so nothing is cut off. The last row joins
+ * every set that is left. Only a few arrays as long as a row are kept, so
+ * the height does not change how much memory is used.
+ * @param width The number of cells in each row
+ * @param height The number of rows
+ * @param context The generator context
+ * @param sink Given each row in turn
+ * @param data Passed to the sink
+ * @return 0 when every row was generated or the value the sink stopped with
+ */
+int stream_eller_maze(int width, uint64_t height, GeneratorContext *context, MazeRowSink sink, void *data) {
+    return stream_masked_eller_maze(width, height, NULL, context, sink, data);
+}
+
+/**
+ * @param mask The maze to take missing cells from, NULL if there are none
+ * @param x The x location of the cell
+ * @param y The y location of the cell
+ * @return If the cell at x,y is in the maze
+ */
+bool eller_has_cell(const Maze *mask, size_t x, uint64_t y) {
+    return mask == NULL || index_in_maze(mask, index_at(mask, (int) x, (int) y));
+}
+
+/**
+ * Eller's algorithm leaving out the cells missing from mask.
+ *
+ * A missing cell splits the sets of a row, cells either side of it are not
+ * joined and the cells below it start new sets. A set none of whose cells
+ * have one below them in the maze cannot link down, so ends as a tree of
+ * it's own. These are not
+ * joined up here, connect_maze_parts has to be run on the finished maze.
+ * @param width The number of cells in each row
+ * @param height The number of rows
+ * @param mask The maze to take missing cells from, NULL for every cell
+ * @param context The generator context
+ * @param sink Given each row in turn
+ * @param data Passed to the sink
+ * @return 0 when every row was generated or the value the sink stopped with
+ */
+int stream_masked_eller_maze(
+        int width, uint64_t height, const Maze *mask,
+        GeneratorContext *context, MazeRowSink sink, void *data
+) {
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator");
+        exit(EXIT_FAILURE);
+    }
+    if (width <= 0 || height == 0) return 0;
+    const size_t row_width = (size_t) width;
+    Random *random = &context->random;
+
+    // sets is the set of each cell, parents joins sets within a row,
+    // remaining counts the cells of each set still to decide on linking down
+    // and next_set is the set a set becomes on the next row
+    size_t *buffer = reserve_indexes(context, checked_size_multiply(row_width, 4));
+    size_t *sets = buffer;
+    size_t *parents = buffer + row_width;
+    size_t *remaining = buffer + row_width * 2;
+    size_t *next_set = buffer + row_width * 3;
+    unsigned char *cells = reserve_generator_buffer(
+            context->directions, &context->direction_capacity, row_width, sizeof(unsigned char)
+    );
+    context->directions = cells;
+
+    for (size_t x = 0; x < row_width; x++) {
+        sets[x] = x;
+        parents[x] = x;
+        remaining[x] = 0;
+        next_set[x] = ELLER_NO_SET;
+        cells[x] = 0;
+    }
+
+    for (uint64_t y = 0; y < height; y++) {
+        const bool last_row = y == height - 1;
+
+        // only keep the link up from the row before
+        for (size_t x = 0; x < row_width; x++) {
+            cells[x] = (cells[x] & DIRECTION_BIT(SOUTH)) ? DIRECTION_BIT(NORTH) : 0;
+            if (!eller_has_cell(mask, x, y)) cells[x] = MISSING_CELL;
+        }
+
+        // join neighbours in different sets, the last row joins them all
+        for (size_t x = 0; x + 1 < row_width; x++) {
+            if ((cells[x] | cells[x + 1]) & MISSING_CELL) continue;
+            size_t set = eller_find_set(parents, sets[x]);
+            size_t east_set = eller_find_set(parents, sets[x + 1]);
+            if (set == east_set) continue;
+            if (last_row || coin_flip(random)) {
+                parents[east_set] = set;
+                cells[x] |= DIRECTION_BIT(EAST);
+                cells[x + 1] |= DIRECTION_BIT(WEST);
+            }
+        }
+
+        if (!last_row) {
+            // only cells with one below them in the maze can link down
+            for (size_t x = 0; x < row_width; x++) {
+                if (cells[x] & MISSING_CELL || !eller_has_cell(mask, x, y + 1)) continue;
+                remaining[eller_find_set(parents, sets[x])]++;
+            }
+            // link down at random, making sure every set does at least once
+            size_t set_count = 0;
+            for (size_t x = 0; x < row_width; x++) {
+                if (cells[x] & MISSING_CELL || !eller_has_cell(mask, x, y + 1)) {
+                    sets[x] = set_count++;
+                    continue;
+                }
+                size_t set = eller_find_set(parents, sets[x]);
+                remaining[set]--;
+                bool down = coin_flip(random) || (remaining[set] == 0 && next_set[set] == ELLER_NO_SET);
+                if (down) {
+                    cells[x] |= DIRECTION_BIT(SOUTH);
+                    if (next_set[set] == ELLER_NO_SET) next_set[set] = set_count++;
+                    sets[x] = next_set[set];
+                } else {
+                    // a new set of it's own
+                    sets[x] = set_count++;
+                }
+            }
+            for (size_t set = 0; set < row_width; set++) {
+                parents[set] = set;
+                remaining[set] = 0;
+                next_set[set] = ELLER_NO_SET;
+            }
+        }
+
+        int result = sink(data, cells, row_width);
+        if (result != 0) return result;
+    }
+    return 0;
+}
+
+/**
+ * Find the set at the root of a set, halving the path to it on the way.
+ * @param parents The parent of each set
+ * @param set The set to start from
+ * @return The root set
+ */
+size_t eller_find_set(size_t *parents, size_t set) {
+    while (parents[set] != set) {
+        parents[set] = parents[parents[set]];
+        set = parents[set];
+    }
+    return set;
+}
+
+/**
+ * Generate a maze in memory using Eller's algorithm.
+ *
+ * Masked mazes are made a row at a time the same way, leaving out the
+ * missing cells, and the trees they cut off are joined up afterwards.
+ * @param maze The maze
+ * @param context The generator context
+ */
+void generate_eller_maze(const Maze *maze, GeneratorContext *context) {
+    if (maze == NULL) {
+        fprintf(stderr, "No maze given to generator");
+        exit(EXIT_FAILURE);
+    }
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator");
+        exit(EXIT_FAILURE);
+    }
+    if (maze->cell_count == (size_t) maze->width * maze->height) {
+        generate_maze_from_rows(maze, context, stream_eller_maze);
+        return;
+    }
+    MazeRows rows;
+    rows.maze = maze;
+    rows.next_row = 0;
+    stream_masked_eller_maze(maze->width, (uint64_t) maze->height, maze, context, maze_row_sink, &rows);
+    connect_maze_parts(maze, context);
+}
+
+#endif //MAZE_ELLER_H
@@ -0,0 +1,160 @@
+#ifndef MAZE_GROWINGTREE_H
+#define MAZE_GROWINGTREE_H
+
+#include "../Maze.h"
+#include "../GeneratorContext.h"
+#include "../utils.h"
+
+// chance out of 100 the mix policy picks the newest cell, otherwise random
+#define GROWING_TREE_MIX_NEWEST 50
+
+// makes sure each policy gets a copy of the engine with the policy fixed
+#if defined(__GNUC__)
+#define GROWING_TREE_INLINE static inline __attribute__((always_inline))
+#else
+#define GROWING_TREE_INLINE static inline
+#endif
+
+/**
+ * How the Growing Tree picks which active cell to grow from next.
+ */
+typedef enum {
+    // the last cell added, the same as the Recursive Backtracker
+    GROWING_TREE_NEWEST,
+    // any cell, like Prim's algorithm
+    GROWING_TREE_RANDOM,
+    // the first cell added, long straight corridors from the start
+    GROWING_TREE_OLDEST,
+    // newest or random, see GROWING_TREE_MIX_NEWEST
+    GROWING_TREE_MIX
+} GrowingTreePolicy;
+
+void generate_growing_tree_newest_maze(const Maze *maze, GeneratorContext *context);
+
+void generate_growing_tree_random_maze(const Maze *maze, GeneratorContext *context);
+
+void generate_growing_tree_oldest_maze(const Maze *maze, GeneratorContext *context);
+
+void generate_growing_tree_mix_maze(const Maze *maze, GeneratorContext *context);
+
+/**
+ * Generate a maze using the Growing Tree algorithm.
+ *
+ * Cells are added to the active list as they are visited. Each step picks an
+ * active cell using the policy and links it to a random unvisited neighbour,
+ * which becomes active too. Cells with no unvisited neighbours are removed.
+ *
+ * Every cell is only added once so the active list is a flat array from
+ * head to tail in context->indexes. Removing the newest cell moves the tail
+ * back and removing any other moves the oldest into it's place, so the
+ * newest cell is always at the tail.
+ *
+ * The policy is known when this is inlined into each generator, so the
+ * picking and removing compile down to just what that policy needs, a plain
+ * stack for the newest.
+ * @param maze The maze
+ * @param context The generator context
+ * @param policy How to pick active cells
+ */
+GROWING_TREE_INLINE void growing_tree_grow(const Maze *maze, GeneratorContext *context, GrowingTreePolicy policy) {
+    if (maze == NULL) {
+        fprintf(stderr, "No maze given to generator");
+        exit(EXIT_FAILURE);
+    }
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator");
+        exit(EXIT_FAILURE);
+    }
+    const size_t total_cells = maze->cell_count;
+    unlink_all_cells(maze);
+    if (total_cells == 0) return;
+
+    Random *random = &context->random;
+    reset_visited(context, maze);
+    size_t *active = reserve_indexes(context, total_cells);
+    size_t head = 0;
+    size_t tail = 0;
+    size_t start = random_index(maze, random);
+    set_visited(context, start);
+    active[tail++] = start;
+    size_t visited_count = 1;
+    // where next_unvisited_index looks for a part not reached yet
+    size_t restart_cursor = 0;
+
+    while (visited_count < total_cells) {
+        if (head == tail) {
+            size_t restart = next_unvisited_index(context, maze, &restart_cursor);
+            set_visited(context, restart);
+            active[tail++] = restart;
+            visited_count++;
+            continue;
+        }
+
+        size_t pick;
+        switch (policy) {
+            case GROWING_TREE_NEWEST:
+                pick = tail - 1;
+                break;
+            case GROWING_TREE_OLDEST:
+                pick = head;
+                break;
+            case GROWING_TREE_MIX:
+                if (random_below(random, 100) < GROWING_TREE_MIX_NEWEST) {
+                    pick = tail - 1;
+                    break;
+                }
+                // fall through
+            case GROWING_TREE_RANDOM:
+            default:
+                pick = head + (size_t) random_below(random, tail - head);
+                break;
+        }
+
+        size_t index = active[pick];
+        unsigned int possible = unvisited_directions(context, maze, index);
+
+        if (possible != 0) {
+            int dir = random_direction_in(possible, random);
+            link_index_in_dir(maze, index, dir);
+            size_t next = get_index_adjacent(maze, index, dir);
+            set_visited(context, next);
+            active[tail++] = next;
+            visited_count++;
+        } else if (policy == GROWING_TREE_NEWEST || (policy != GROWING_TREE_OLDEST && pick == tail - 1)) {
+            tail--;
+        } else {
+            active[pick] = active[head++];
+        }
+    }
+}
+
+void generate_growing_tree_newest_maze(const Maze *maze, GeneratorContext *context) {
+    growing_tree_grow(maze, context, GROWING_TREE_NEWEST);
+}
+
+void generate_growing_tree_random_maze(const Maze *maze, GeneratorContext *context) {
+    growing_tree_grow(maze, context, GROWING_TREE_RANDOM);
+}
+
+void generate_growing_tree_oldest_maze(const Maze *maze, GeneratorContext *context) {
+    growing_tree_grow(maze, context, GROWING_TREE_OLDEST);
+}
+
+void generate_growing_tree_mix_maze(const Maze *maze, GeneratorContext *context) {
+    growing_tree_grow(maze, context, GROWING_TREE_MIX);
+}
+
+/**
+ * Find the Growing Tree generator for a policy name.
+ * @param policy newest, random, oldest or mix
+ * @return The generator or NULL if the policy is not known
+ */
+void (*growing_tree_generator(const char *policy))(const Maze *, GeneratorContext *) {
+    if (strcmp(policy, "newest") == 0) return generate_growing_tree_newest_maze;
+    if (strcmp(policy, "random") == 0) return generate_growing_tree_random_maze;
+    if (strcmp(policy, "oldest") == 0) return generate_growing_tree_oldest_maze;
+    if (strcmp(policy, "mix") == 0) return generate_growing_tree_mix_maze;
+    return NULL;
+}
+
+#endif //MAZE_GROWINGTREE_H
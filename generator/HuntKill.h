@@ -2,127 +2,125 @@
 #define MAZE_HUNTKILL_H
 
 #include "../Maze.h"
+#include "../GeneratorContext.h"
 #include "../utils.h"
 
-void generate_hunt_and_kill_maze(const Maze *maze) {
+/**
+ * Mark a cell as visited and mark the rows that could now have a cell for
+ * the hunt to find.
+ * @param context The generator context
+ * @param maze The maze
+ * @param index The grid index of the cell
+ * @param y The row the cell is in
+ * @param hunt_y The first row the hunt looks at, lowered to the first
+ * marked row
+ */
+void hunt_and_kill_visit(GeneratorContext *context, const Maze *maze, size_t index, int y, int *hunt_y) {
+    set_visited(context, index);
+    int first = y > 0 ? y - 1 : 0;
+    int last = y < maze->height - 1 ? y + 1 : y;
+    for (int row = first; row <= last; row++) {
+        mark_row(context, row);
+    }
+    if (first < *hunt_y) *hunt_y = first;
+}
+
+void generate_hunt_and_kill_maze(const Maze *maze, GeneratorContext *context) {
     if (maze == NULL) {
         fprintf(stderr, "No maze given to generator");
         exit(EXIT_FAILURE);
     }
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator");
+        exit(EXIT_FAILURE);
+    }
     const int width = maze->width;
     const int height = maze->height;
-    const int total_cells = maze->cell_count;
+    const size_t total_cells = maze->cell_count;
     unlink_all_cells(maze);
+    if (total_cells == 0) return;
+
+    reset_visited(context, maze);
+
+    // A row is marked when a cell in it or next to it is visited and
+    // unmarked when a hunt finds nothing in it, so the hunt only looks at
+    // marked rows. hunt_x holds where to start in each row, every cell
+    // before it is visited or missing.
+    reset_row_marks(context, maze);
+    size_t *hunt_x = reserve_indexes(context, (size_t) height);
+    memset(hunt_x, 0, sizeof(size_t) * height);
+    int hunt_y = height;
 
-    Cell *visited[height][width];
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            visited[y][x] = NULL;
-        }
-    }
     // Random current cell
-    Cell *current = random_cell(maze);
-    int visited_count = 1;
-    visited[current->y][current->x] = current;
+    size_t current = random_index(maze, &context->random);
+    int y = index_y(maze, current);
+    size_t visited_count = 1;
+    hunt_and_kill_visit(context, maze, current, y, &hunt_y);
+    // where next_unvisited_index looks for a part not reached yet
+    size_t restart_cursor = 0;
 
     while (visited_count < total_cells) {
-        if (current == NULL) break;
-
         // Get next cell that is not visited and not linked to
-        int neighbour_count = 0;
-        Cell** possible_next = get_all_neighbouring_cells(maze, current, &neighbour_count);
-        int possible_next_null_count = 0;
-        for (int i = 0; i < neighbour_count; i ++) {
-            Cell* possible = possible_next[i];
-            if (possible == NULL ||current->neighbours[i] == possible || visited[possible->y][possible->x] == possible) {
-                possible_next[i] = NULL;
-                possible_next_null_count ++;
-            }
-        }
-        Cell *next = NULL;
-        if (possible_next_null_count < neighbour_count) {
-            while(next == NULL) {
-                next = possible_next[rand() % neighbour_count];
-            }
-        }
+        unsigned int possible = unvisited_directions(context, maze, current);
 
-        free(possible_next);
-        possible_next = NULL;
-        bool hunt_time = next == NULL;
-        if (!hunt_time) {
+        if (possible != 0) {
             // random walk
-            int x = next->x;
-            int y = next->y;
-            if (visited[y][x] != next) {
-                visited[y][x] = next;
-                visited_count++;
-                link_adjacent_cells(current, next);
-                current = next;
-            }
+            int dir = random_direction_in(possible, &context->random);
+            size_t next = get_index_adjacent(maze, current, dir);
+            link_index_in_dir(maze, current, dir);
+            if (dir == NORTH) y--;
+            else if (dir == SOUTH) y++;
+            hunt_and_kill_visit(context, maze, next, y, &hunt_y);
+            visited_count++;
+            current = next;
+            continue;
         }
-        if (hunt_time) {
-            // hunt
-            bool finished = false;
-            for (int y = 0; y < height; y++) {
-                for (int x = 0; x < width; x++) {
-                    Cell *this_cell = visited[y][x];
-                    if (this_cell == NULL) {
-                        this_cell = cell_at(maze, x, y);
-                        if (this_cell == NULL) continue;
-                        int cells_count = 0;
-                        Cell **cells = get_all_neighbouring_cells(maze, this_cell, &cells_count);
-                        int null_count = 0;
-                        for (int i = 0; i < cells_count; i++) {
-                            Cell *neighbour = cells[i];
-                            if (neighbour == NULL || visited[neighbour->y][neighbour->x] == NULL) {
-                                null_count++;
-                                cells[i] = NULL;
-                            }
-                        }
-                        if (null_count >= cells_count) {
-                            free(cells);
-                            cells = NULL;
-                            continue; // all neighbours are unvisited
-                        }
 
-                        // find visited neighbour
-                        Cell *visited_neighbour = NULL;
-                        while (visited_neighbour == NULL) {
-                            int i = rand() % cells_count;
-                            visited_neighbour = cells[i];
-                        }
-                        link_adjacent_cells(this_cell, visited_neighbour);
-                        visited[y][x] = this_cell;
-                        visited_count++;
-                        current = this_cell;
-                        finished = true;
-                        free(cells);
-                        cells = NULL;
-                        break;
-                    }
-                }
-                if (finished) {
-                    break;
-                }
+        // hunt for the first unvisited cell next to a visited one
+        bool finished = false;
+        for (hunt_y = next_marked_row(context, maze, hunt_y);
+             hunt_y < height;
+             hunt_y = next_marked_row(context, maze, hunt_y + 1)) {
+            size_t x = hunt_x[hunt_y];
+            size_t index = index_at(maze, (int) x, hunt_y);
+            // skip cells that will never be hunted again
+            while (x < (size_t) width && (is_visited(context, index) || !index_in_maze(maze, index))) {
+                x++;
+                index = get_index_adjacent(maze, index, EAST);
             }
+            hunt_x[hunt_y] = x;
+
+            for (; x < (size_t) width; x++, index = get_index_adjacent(maze, index, EAST)) {
+                if (is_visited(context, index) || !index_in_maze(maze, index)) continue;
 
-            // Something went wrong with algorithm above
-            if (!finished) {
-                fprintf(stderr, "Failed to finish hunting properly\n");
-                fprintf(stderr, "The following cells were corrupted:\n");
-                for (int y = 0; y < height; y++) {
-                    for (int x = 0; x < width; x++) {
-                        Cell *visited_cell = visited[y][x];
-                        if(visited_cell != cell_at(maze, x, y)) {
-                            fprintf(stderr, "%d,%d\n", x, y);
-                        }
-                    }
+                // find visited neighbours, the border is never visited
+                unsigned int visited_dirs = visited_directions(context, maze, index);
+                if (visited_dirs == 0) {
+                    continue; // all neighbours are unvisited
                 }
+
+                link_index_in_dir(maze, index, random_direction_in(visited_dirs, &context->random));
+                y = hunt_y;
+                hunt_and_kill_visit(context, maze, index, y, &hunt_y);
+                visited_count++;
+                current = index;
+                finished = true;
+                break;
+            }
+            if (finished) {
                 break;
             }
+            unmark_row(context, hunt_y);
         }
 
-
+        if (!finished) {
+            // nothing left to reach from the visited cells, so the mask has
+            // split the maze, start again in a part not reached yet
+            current = next_unvisited_index(context, maze, &restart_cursor);
+            y = index_y(maze, current);
+            hunt_and_kill_visit(context, maze, current, y, &hunt_y);
+            visited_count++;
+        }
     }
 
 }
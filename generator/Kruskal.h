@@ -2,67 +2,60 @@
 #define MAZE_KRUSKAL_H
 
 #include "../Maze.h"
+#include "../GeneratorContext.h"
 #include "../utils.h"
 
-void generate_kruskal_maze(const Maze *maze) {
+void generate_kruskal_maze(const Maze *maze, GeneratorContext *context) {
     if (maze == NULL) {
         fprintf(stderr, "No maze given to generator");
         exit(EXIT_FAILURE);
     }
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator");
+        exit(EXIT_FAILURE);
+    }
     const int width = maze->width;
     const int height = maze->height;
-    const int total_cells = maze->cell_count;
+    const size_t total_cells = maze->cell_count;
 
     unlink_all_cells(maze);
+    if (total_cells == 0) return;
+
+    // every cell starts in a set of it's own
+    reset_sets(context, maze);
 
-    // Create an initial set of nodes that are all not connected
-    CellTreeNode *nodes[height][width];
-    CellTreeNode *first_non_null = NULL;
+    // list the walls between cells, each one is the grid index of the cell
+    // to the west or north of it shifted up with the low bit set for a
+    // north south wall
+    size_t *walls = reserve_indexes(context, checked_size_multiply(total_cells, 2));
+    size_t wall_count = 0;
     for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            Cell *cell = cell_at(maze, x, y);
-            if (cell == NULL) {
-                nodes[y][x] = NULL;
-                continue;
+        size_t index = index_at(maze, 0, y);
+        for (int x = 0; x < width; x++, index = get_index_adjacent(maze, index, EAST)) {
+            if (!index_in_maze(maze, index)) continue;
+            if (index_in_maze(maze, get_index_adjacent(maze, index, EAST))) {
+                walls[wall_count++] = index << 1u;
+            }
+            if (index_in_maze(maze, get_index_adjacent(maze, index, SOUTH))) {
+                walls[wall_count++] = (index << 1u) | 1u;
             }
-            CellTreeNode *node = new_cell_tree_node(cell);
-            nodes[y][x] = node;
-            if (first_non_null == NULL) first_non_null = node;
         }
     }
 
-    CellTreeNode *root = first_non_null;
-    int total_connected_count;
-    do {
-        // get a cell and an unlinked neighbour that aren't in the same
-        Cell *cell = NULL;
-        Cell *unlinked = NULL;
-        CellTreeNode *node1 = NULL;
-        CellTreeNode *node2 = NULL;
-
-        while (cell == NULL && unlinked == NULL) {
-            cell = random_cell(maze);
-            unlinked = random_unlinked_cell((Maze *) maze, cell);
-            if (unlinked == NULL) continue;
-            node1 = nodes[cell->y][cell->x];
-            node2 = nodes[unlinked->y][unlinked->x];
-
-            bool in_same_tree = in_same_cell_tree(node1, node2);
-            if (!in_same_tree) {
-                link_adjacent_cells(cell, unlinked);
-                append_cell_tree_node(node1, node2);
-            } else {
-                cell = NULL;
-                unlinked = NULL;
-            }
+    // shuffle as we go, stopping once every cell is in one tree
+    size_t links = 0;
+    for (size_t i = 0; i < wall_count && links < total_cells - 1; i++) {
+        size_t pick = i + random_below(&context->random, wall_count - i);
+        size_t wall = walls[pick];
+        walls[pick] = walls[i];
+
+        size_t index = wall >> 1u;
+        int dir = (wall & 1u) ? SOUTH : EAST;
+        if (join_sets(context, index, get_index_adjacent(maze, index, dir))) {
+            link_index_in_dir(maze, index, dir);
+            links++;
         }
-
-        root = get_root_cell_tree_node(root);
-        total_connected_count = total_cells_in_tree(root);
-    } while (total_connected_count < total_cells);
-
-    root = get_root_cell_tree_node(root);
-    delete_cell_tree(root);
+    }
 }
 
 #endif //MAZE_KRUSKAL_H
@@ -0,0 +1,96 @@
+#ifndef MAZE_PRIM_H
+#define MAZE_PRIM_H
+
+#include "../Maze.h"
+#include "../GeneratorContext.h"
+#include "../utils.h"
+
+// slot of a grid index that is not in the frontier, as set by reset_slots
+#define PRIM_NO_SLOT SIZE_MAX
+
+size_t prim_visit(GeneratorContext *context, const Maze *maze, size_t index, size_t frontier_count);
+
+/**
+ * Generate a maze using a randomised version of Prim's algorithm.
+ *
+ * The frontier is every unvisited cell next to a visited one. A random one
+ * is taken out, linked to a random visited neighbour and it's unvisited
+ * neighbours join the frontier. The frontier is a flat array in
+ * context->indexes and context->slots holds where each cell is in it, so
+ * adding, checking, picking and removing a cell all take the same time
+ * however big the frontier gets.
+ *
+ * Parts of a masked maze it cannot reach are started again from
+ * next_unvisited_index.
+ * @param maze The maze
+ * @param context The generator context
+ */
+void generate_prim_maze(const Maze *maze, GeneratorContext *context) {
+    if (maze == NULL) {
+        fprintf(stderr, "No maze given to generator");
+        exit(EXIT_FAILURE);
+    }
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator");
+        exit(EXIT_FAILURE);
+    }
+    const size_t total_cells = maze->cell_count;
+    unlink_all_cells(maze);
+    if (total_cells == 0) return;
+
+    reset_visited(context, maze);
+    size_t *slots = reset_slots(context, maze);
+    // a cell is only ever in the frontier once
+    size_t *frontier = reserve_indexes(context, total_cells);
+    size_t frontier_count = prim_visit(context, maze, random_index(maze, &context->random), 0);
+    size_t visited_count = 1;
+    // where next_unvisited_index looks for a part not reached yet
+    size_t restart_cursor = 0;
+
+    while (visited_count < total_cells) {
+        if (frontier_count == 0) {
+            size_t start = next_unvisited_index(context, maze, &restart_cursor);
+            frontier_count = prim_visit(context, maze, start, frontier_count);
+            visited_count++;
+            continue;
+        }
+
+        // take a random cell out, moving the last one into it's place
+        size_t slot = (size_t) random_below(&context->random, frontier_count);
+        size_t index = frontier[slot];
+        size_t last = frontier[--frontier_count];
+        frontier[slot] = last;
+        slots[last] = slot;
+        slots[index] = PRIM_NO_SLOT;
+
+        unsigned int visited_dirs = visited_directions(context, maze, index);
+        link_index_in_dir(maze, index, random_direction_in(visited_dirs, &context->random));
+        frontier_count = prim_visit(context, maze, index, frontier_count);
+        visited_count++;
+    }
+}
+
+/**
+ * Mark a cell as visited and add it's unvisited neighbours to the frontier.
+ * @param context The generator context
+ * @param maze The maze
+ * @param index The grid index of the cell
+ * @param frontier_count The number of cells in the frontier
+ * @return The new number of cells in the frontier
+ */
+size_t prim_visit(GeneratorContext *context, const Maze *maze, size_t index, size_t frontier_count) {
+    set_visited(context, index);
+    size_t *frontier = context->indexes;
+    size_t *slots = context->slots;
+    unsigned int neighbours = get_neighbour_mask(maze, index);
+    for (int dir = 0; dir < DIRECTION_COUNT; dir++) {
+        if (!(neighbours & DIRECTION_BIT(dir))) continue;
+        size_t adjacent = get_index_adjacent(maze, index, dir);
+        if (is_visited(context, adjacent) || slots[adjacent] != PRIM_NO_SLOT) continue;
+        slots[adjacent] = frontier_count;
+        frontier[frontier_count++] = adjacent;
+    }
+    return frontier_count;
+}
+
+#endif //MAZE_PRIM_H
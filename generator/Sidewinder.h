@@ -1,48 +1,115 @@
 #ifndef MAZE_SIDEWINDER_H
 #define MAZE_SIDEWINDER_H
 #include "../Maze.h"
+#include "../GeneratorContext.h"
 #include "../utils.h"
 
-void generate_sidewinder_maze(const Maze *maze) {
+typedef struct {
+    const Maze *maze;
+    uint64_t seed;
+    int parity;
+} SidewinderRows;
+
+void sidewinder_row(const Maze *maze, int y, Random *random);
+
+void sidewinder_rows_task(void *data, size_t start, size_t end);
+
+/**
+ * Generate a maze using the Sidewinder algorithm.
+ *
+ * Each row only links within itself and to the row above, so rows are
+ * shared out between threads. Every row has it's own random stream so the
+ * maze for a given seed is the same however many threads are used.
+ * @param maze The maze
+ * @param context The generator context
+ */
+void generate_sidewinder_maze(const Maze *maze, GeneratorContext *context) {
     if (maze == NULL) {
         fprintf(stderr, "No maze given to generator");
         exit(EXIT_FAILURE);
     }
-    int width = maze->width, height = maze->height;
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator");
+        exit(EXIT_FAILURE);
+    }
     unlink_all_cells(maze);
 
-    CellListEntry *run_of_cells = NULL;
-    bool new_run = true;
-    for (int y = height - 1; y >= 0; y--) {
-        for (int x = 0; x < width; x++) {
-            Cell *cell = cell_at(maze, x, y);
-            if (y == 0) {
-                link_cell_in_dir(maze, cell, EAST);
+    // Linking north writes to the row above, so even and odd rows take turns
+    // to keep threads from writing to the same cells
+    SidewinderRows rows;
+    rows.maze = maze;
+    rows.seed = next_random(&context->random);
+    for (int parity = 0; parity < 2; parity++) {
+        rows.parity = parity;
+        size_t row_count = (size_t) (maze->height - parity + 1) / 2;
+        run_parallel(context->thread_count, row_count, sidewinder_rows_task, &rows);
+    }
+    // runs with nothing to the north to link to are left as trees of their
+    // own when cells are missing
+    if (maze->cell_count != (size_t) maze->width * maze->height) {
+        connect_maze_parts(maze, context);
+    }
+}
+
+void sidewinder_rows_task(void *data, size_t start, size_t end) {
+    const SidewinderRows *rows = data;
+    for (size_t i = start; i < end; i++) {
+        int y = (int) (i * 2) + rows->parity;
+        Random random;
+        seed_random_stream(&random, rows->seed, (uint64_t) y);
+        sidewinder_row(rows->maze, y, &random);
+    }
+}
+
+/**
+ * Link the cells of one row.
+ * @param maze The maze
+ * @param y The row
+ * @param random The random state for this row
+ */
+void sidewinder_row(const Maze *maze, int y, Random *random) {
+    const int width = maze->width;
+    size_t index = index_at(maze, 0, y);
+    // the run is every cell from run_start up to the current x, missing
+    // counts how many of them have no cell to the north
+    int run_start = 0;
+    int missing = 0;
+    for (int x = 0; x < width; x++, index = get_index_adjacent(maze, index, EAST)) {
+        if (!index_in_maze(maze, index)) {
+            // a gap in the maze ends the run
+            run_start = x + 1;
+            missing = 0;
+            continue;
+        }
+        if (y == 0) {
+            link_index_in_dir(maze, index, EAST);
+        } else {
+            if (!index_in_maze(maze, get_index_adjacent(maze, index, NORTH))) {
+                missing++;
+            }
+            bool should_east = coin_flip(random);
+            bool can_east = index_in_maze(maze, get_index_adjacent(maze, index, EAST));
+            if (should_east && can_east) {
+                link_index_in_dir(maze, index, EAST);
             } else {
-                if (new_run) {
-                    run_of_cells = new_cell_list_entry(cell);
-                    new_run = false;
-                } else {
-                    push_to_cell_list(run_of_cells, cell);
-                }
-                bool should_east = coin_flip();
-                if (should_east && x < width-1) {
-                    link_cell_in_dir(maze, cell, EAST);
-                } else {
-                    Cell *random = pick_from_cell_list(run_of_cells);
-                    link_cell_in_dir(maze, random, NORTH);
-                    delete_cell_list(run_of_cells);
-                    run_of_cells = NULL;
-                    new_run = true;
+                int candidates = x - run_start + 1 - missing;
+                if (candidates > 0) {
+                    int pick = (int) random_below(random, candidates);
+                    int north_x = run_start + pick;
+                    if (missing > 0) {
+                        // skip over the cells that cannot be linked north
+                        for (north_x = run_start;; north_x++) {
+                            size_t above = index_at(maze, north_x, y - 1);
+                            if (index_in_maze(maze, above) && pick-- == 0) break;
+                        }
+                    }
+                    link_index_in_dir(maze, index_at(maze, north_x, y), NORTH);
                 }
+                run_start = x + 1;
+                missing = 0;
             }
         }
     }
-    if(run_of_cells != NULL) {
-        free(run_of_cells);
-        run_of_cells = NULL;
-    }
-
 }
 
 #endif //MAZE_SIDEWINDER_H
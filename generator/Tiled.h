@@ -0,0 +1,167 @@
+#ifndef MAZE_TILED_H
+#define MAZE_TILED_H
+
+#include "../Maze.h"
+#include "../GeneratorContext.h"
+#include "../utils.h"
+#include "Wilson.h"
+
+typedef struct {
+    const Maze *maze;
+    void (*generator)(const Maze *, GeneratorContext *);
+    int tile_size;
+    int tiles_x;
+    uint64_t seed;
+} TiledMaze;
+
+void tiled_maze_task(void *data, size_t start, size_t end);
+
+/**
+ * Generate a maze by splitting it into square tiles, generating a maze in
+ * each tile at the same time and then joining the tiles up.
+ *
+ * Each tile is generated on it's own in a small maze with it's own context
+ * and random stream, then copied in. The tiles are joined by a random
+ * spanning tree over the grid of tiles, made with Wilson's algorithm, with
+ * one passage through a random point of each edge it uses. As each tile is a
+ * perfect maze and they are joined by a tree the whole maze is perfect too,
+ * as long as the generator makes perfect mazes.
+ *
+ * The maze only depends on the seed and tile size, not the thread count.
+ * Mazes with cells missing are generated whole, as a tile could be split in
+ * two by them.
+ * @param maze The maze
+ * @param context The generator context
+ * @param maze_generator The generator to use in each tile
+ * @param tile_size The width and height of each tile, the tiles on the right
+ * and bottom may be smaller
+ */
+void generate_tiled_maze(
+        const Maze *maze,
+        GeneratorContext *context,
+        void (*maze_generator)(const Maze *, GeneratorContext *),
+        int tile_size
+) {
+    if (maze == NULL) {
+        fprintf(stderr, "No maze given to generator");
+        exit(EXIT_FAILURE);
+    }
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator");
+        exit(EXIT_FAILURE);
+    }
+    if (tile_size < 1) {
+        fprintf(stderr, "Tile size must be at least 1, was %d", tile_size);
+        exit(EXIT_FAILURE);
+    }
+    const int width = maze->width;
+    const int height = maze->height;
+    const int tiles_x = (width - 1) / tile_size + 1;
+    const int tiles_y = (height - 1) / tile_size + 1;
+    if (maze->cell_count != (size_t) width * height || (tiles_x == 1 && tiles_y == 1)) {
+        maze_generator(maze, context);
+        return;
+    }
+
+    TiledMaze tiled;
+    tiled.maze = maze;
+    tiled.generator = maze_generator;
+    tiled.tile_size = tile_size;
+    tiled.tiles_x = tiles_x;
+    tiled.seed = next_random(&context->random);
+    run_parallel(context->thread_count, (size_t) tiles_x * tiles_y, tiled_maze_task, &tiled);
+
+    // join the tiles with a spanning tree of the tile grid
+    Maze *tiles = new_maze(tiles_x, tiles_y, false);
+    generate_wilson_maze(tiles, context);
+    for (int tile_y = 0; tile_y < tiles_y; tile_y++) {
+        size_t tile = index_at(tiles, 0, tile_y);
+        for (int tile_x = 0; tile_x < tiles_x; tile_x++, tile = get_index_adjacent(tiles, tile, EAST)) {
+            unsigned int walls = get_open_walls(tiles, tile);
+            int x = tile_x * tile_size;
+            int y = tile_y * tile_size;
+            // only tiles on the right and bottom can be smaller, so a tile
+            // with one to the east or south is full size that way
+            int tile_width = width - x < tile_size ? width - x : tile_size;
+            int tile_height = height - y < tile_size ? height - y : tile_size;
+            if (walls & DIRECTION_BIT(EAST)) {
+                int passage = (int) random_below(&context->random, (uint64_t) tile_height);
+                link_index_in_dir(maze, index_at(maze, x + tile_size - 1, y + passage), EAST);
+            }
+            if (walls & DIRECTION_BIT(SOUTH)) {
+                int passage = (int) random_below(&context->random, (uint64_t) tile_width);
+                link_index_in_dir(maze, index_at(maze, x + passage, y + tile_size - 1), SOUTH);
+            }
+        }
+    }
+    delete_maze(tiles);
+}
+
+/**
+ * Generate some tiles, reusing one context, tile sized maze and row buffer
+ * for all of them.
+ */
+void tiled_maze_task(void *data, size_t start, size_t end) {
+    const TiledMaze *tiled = data;
+    const Maze *maze = tiled->maze;
+    const int tile_size = tiled->tile_size;
+    GeneratorContext *context = new_generator_context(0);
+    context->thread_count = 1;
+    unsigned char *row = malloc((size_t) tile_size);
+    if (row == NULL) {
+        fprintf(stderr, "Unable to allocate tile row");
+        exit(EXIT_FAILURE);
+    }
+    Maze *tile = NULL;
+
+    for (size_t i = start; i < end; i++) {
+        int x = (int) (i % (size_t) tiled->tiles_x) * tile_size;
+        int y = (int) (i / (size_t) tiled->tiles_x) * tile_size;
+        int width = maze->width - x < tile_size ? maze->width - x : tile_size;
+        int height = maze->height - y < tile_size ? maze->height - y : tile_size;
+        if (tile == NULL || tile->width != width || tile->height != height) {
+            if (tile != NULL) delete_maze(tile);
+            tile = new_maze(width, height, false);
+        }
+
+        Random random;
+        seed_random_stream(&random, tiled->seed, (uint64_t) i);
+        generate_maze_with_seed(tile, context, tiled->generator, next_random(&random));
+
+        // the tile's border is missing cells so it never links out of it
+        for (int row_y = 0; row_y < height; row_y++) {
+            read_row_cells(tile, 0, row_y, row, (size_t) width);
+            write_row_cells(maze, x, y + row_y, row, (size_t) width);
+        }
+    }
+
+    if (tile != NULL) delete_maze(tile);
+    free(row);
+    delete_generator_context(context);
+}
+
+/**
+ * Generate a maze from a given seed, in tiles if tile_size is above 0.
+ * @param maze The maze to generate
+ * @param context The generator context
+ * @param maze_generator The generator to use
+ * @param seed The seed to generate from
+ * @param tile_size The size of the tiles or 0 to generate the maze whole
+ */
+void generate_maze_with_seed_in_tiles(
+        const Maze *maze,
+        GeneratorContext *context,
+        void (*maze_generator)(const Maze *, GeneratorContext *),
+        uint64_t seed,
+        int tile_size
+) {
+    if (tile_size <= 0) {
+        generate_maze_with_seed(maze, context, maze_generator, seed);
+        return;
+    }
+    seed_random(&context->random, seed);
+    ((Maze *) maze)->seed = seed;
+    generate_tiled_maze(maze, context, maze_generator, tile_size);
+}
+
+#endif //MAZE_TILED_H
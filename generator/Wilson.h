@@ -0,0 +1,98 @@
+#ifndef MAZE_WILSON_H
+#define MAZE_WILSON_H
+
+#include "../Maze.h"
+#include "../GeneratorContext.h"
+#include "../utils.h"
+
+void generate_wilson_maze(const Maze *maze, GeneratorContext *context);
+
+void wilson_walk(const Maze *maze, GeneratorContext *context, size_t start);
+
+/**
+ * Generate a maze using Wilson's algorithm.
+ *
+ * Loop erased random walks are made from each cell not yet in the maze until
+ * they hit one that is. Like Aldous-Broder every possible maze is equally
+ * likely but it finishes far quicker.
+ *
+ * The walk stores the direction it last left each cell in, so walking back
+ * from the start only follows the loop free path. A separate root is picked
+ * for every group of cells that cannot reach each other so masked mazes
+ * finish too.
+ * @param maze The maze
+ * @param context The generator context
+ */
+void generate_wilson_maze(const Maze *maze, GeneratorContext *context) {
+    if (maze == NULL) {
+        fprintf(stderr, "No maze given to generator");
+        exit(EXIT_FAILURE);
+    }
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator");
+        exit(EXIT_FAILURE);
+    }
+    unlink_all_cells(maze);
+    const size_t total_cells = maze->cell_count;
+    if (total_cells == 0) return;
+
+    reset_visited(context, maze);
+    unsigned char *directions = reserve_directions(context, maze);
+    const int width = maze->width;
+    const int height = maze->height;
+
+    // the walks end at a random cell, or the first cell of groups that
+    // cannot reach it when cells are missing
+    size_t root = random_index(maze, &context->random);
+    set_visited(context, root);
+    if (total_cells != (size_t) width * height) {
+        memset(directions, PART_UNSEEN, maze->grid_size);
+        flood_maze_part(maze, context, root);
+        for (int y = 0; y < height; y++) {
+            size_t index = index_at(maze, 0, y);
+            for (int x = 0; x < width; x++, index = get_index_adjacent(maze, index, EAST)) {
+                if (index_in_maze(maze, index) && directions[index] == PART_UNSEEN) {
+                    flood_maze_part(maze, context, index);
+                    set_visited(context, index);
+                }
+            }
+        }
+    }
+
+    for (int y = 0; y < height; y++) {
+        size_t index = index_at(maze, 0, y);
+        for (int x = 0; x < width; x++, index = get_index_adjacent(maze, index, EAST)) {
+            if (index_in_maze(maze, index) && !is_visited(context, index)) {
+                wilson_walk(maze, context, index);
+            }
+        }
+    }
+}
+
+/**
+ * Walk randomly from start until a cell in the maze is reached, then link
+ * the path back without any loops it made.
+ * @param maze The maze
+ * @param context The generator context
+ * @param start The grid index to start from, must not be in the maze yet
+ */
+void wilson_walk(const Maze *maze, GeneratorContext *context, size_t start) {
+    unsigned char *directions = context->directions;
+    size_t current = start;
+    while (!is_visited(context, current)) {
+        int dir = random_direction_in(get_neighbour_mask(maze, current), &context->random);
+        // coming back to a cell overwrites it's direction, erasing the loop
+        directions[current] = (unsigned char) dir;
+        current = get_index_adjacent(maze, current, dir);
+    }
+
+    current = start;
+    while (!is_visited(context, current)) {
+        int dir = directions[current];
+        set_visited(context, current);
+        link_index_in_dir(maze, current, dir);
+        current = get_index_adjacent(maze, current, dir);
+    }
+}
+
+#endif //MAZE_WILSON_H
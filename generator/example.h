@@ -3,29 +3,34 @@
 
 #include "../utils.h"
 #include "../Maze.h"
+#include "../GeneratorContext.h"
 
-void generate_example_maze(const Maze *maze);
+void generate_example_maze(const Maze *maze, GeneratorContext *context);
 
-void generate_example_zig_zag_maze(const Maze *maze);
+void generate_example_zig_zag_maze(const Maze *maze, GeneratorContext *context);
 
-void generate_example_spiral_maze(const Maze *maze);
+void generate_example_spiral_maze(const Maze *maze, GeneratorContext *context);
 
-void noop_generate_maze(const Maze *maze);
+void noop_generate_maze(const Maze *maze, GeneratorContext *context);
 
-void generate_example_maze(const Maze *maze) {
+void generate_example_maze(const Maze *maze, GeneratorContext *context) {
     if (maze == NULL) {
         fprintf(stderr, "No maze given to generator\n");
         exit(EXIT_FAILURE);
     }
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator\n");
+        exit(EXIT_FAILURE);
+    }
 
-    if (coin_flip()) {
-        generate_example_spiral_maze(maze);
+    if (coin_flip(&context->random)) {
+        generate_example_spiral_maze(maze, context);
     } else {
-        generate_example_zig_zag_maze(maze);
+        generate_example_zig_zag_maze(maze, context);
     }
 }
 
-void generate_example_zig_zag_maze(const Maze *maze) {
+void generate_example_zig_zag_maze(const Maze *maze, GeneratorContext *context) {
     if (maze == NULL) {
         fprintf(stderr, "No maze given to generator\n");
         exit(EXIT_FAILURE);
@@ -33,12 +38,6 @@ void generate_example_zig_zag_maze(const Maze *maze) {
 
     const int width = maze->width;
     const int height = maze->height;
-    const int total_cells = maze->cell_count;
-
-    if (total_cells != width * height) {
-        fprintf(stderr, "Example generation only works on full grids\n");
-        exit(EXIT_FAILURE);
-    }
 
     unlink_all_cells(maze);
 
@@ -46,24 +45,20 @@ void generate_example_zig_zag_maze(const Maze *maze) {
     for (int y = 0; y < height; y++) {
         if (right) {
             for (int x = 0; x < width; x++) {
-                Cell *cell = cell_at(maze, x, y);
-                if (cell == NULL) continue;
                 int dir = x < width - 1 ? EAST : SOUTH;
-                link_cell_in_dir(maze, cell, dir);
+                link_index_in_dir(maze, index_at(maze, x, y), dir);
             }
         } else {
             for (int x = width - 1; x >= 0; x--) {
-                Cell *cell = cell_at(maze, x, y);
-                if (cell == NULL) continue;
                 int dir = x > 0 ? WEST : SOUTH;
-                link_cell_in_dir(maze, cell, dir);
+                link_index_in_dir(maze, index_at(maze, x, y), dir);
             }
         }
         right = !right;
     }
 }
 
-void generate_example_spiral_maze(const Maze *maze) {
+void generate_example_spiral_maze(const Maze *maze, GeneratorContext *context) {
     if (maze == NULL) {
         fprintf(stderr, "No maze given to generator\n");
         exit(EXIT_FAILURE);
@@ -71,10 +66,9 @@ void generate_example_spiral_maze(const Maze *maze) {
 
     const int width = maze->width;
     const int height = maze->height;
-    const int total_cells = maze->cell_count;
 
-    if (total_cells != width * height) {
-        fprintf(stderr, "Example generation only works on full grids\n");
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator\n");
         exit(EXIT_FAILURE);
     }
 
@@ -83,25 +77,26 @@ void generate_example_spiral_maze(const Maze *maze) {
     const int min_dimension = width < height ? width : height;
     const int half_size = min_dimension / 2;
 
-    int dir = random_direction();
+    int dir = random_direction(&context->random);
     int size = 1;
-    Cell *cell = cell_at(maze, half_size, half_size);
-    while (cell != NULL) {
-        for (int i = 0; i < size; i++) {
-            link_cell_in_dir(maze, cell, dir);
-            cell = get_cell_adjacent(maze, cell, dir);
+    // stop as soon as the spiral walks into the border
+    size_t index = index_at(maze, half_size, half_size);
+    while (index_in_maze(maze, index)) {
+        for (int i = 0; i < size && index_in_maze(maze, index); i++) {
+            link_index_in_dir(maze, index, dir);
+            index = get_index_adjacent(maze, index, dir);
         }
         dir = rotate_clockwise(dir);
-        for (int i = 0; i < size; i++) {
-            link_cell_in_dir(maze, cell, dir);
-            cell = get_cell_adjacent(maze, cell, dir);
+        for (int i = 0; i < size && index_in_maze(maze, index); i++) {
+            link_index_in_dir(maze, index, dir);
+            index = get_index_adjacent(maze, index, dir);
         }
         dir = rotate_clockwise(dir);
         size++;
     }
 }
 
-void noop_generate_maze(const Maze *maze) {
+void noop_generate_maze(const Maze *maze, GeneratorContext *context) {
 }
 
 #endif //MAZE_EXAMPLE_H
@@ -3,6 +3,8 @@
 
 #include <stdio.h>
 #include "Maze.h"
+#include "GeneratorContext.h"
+#include "RowStream.h"
 
 /**
  * Write maze to a binary file
@@ -31,11 +33,60 @@ Maze *read_maze(FILE *file);
  *
  * The 5th bit is set when the Cell is NULL.
  *
+ * This is the same layout as a Maze grid entry.
+ *
  * @param cell The cell to pack
  * @return a byte representing the cell
  */
 unsigned char pack_cell(const Cell *cell);
 
+/**
+ * Write a 64 bit integer in little endian order so files are portable
+ * @param file The file to write to
+ * @param value The value to write
+ */
+void write_uint64(FILE *file, uint64_t value);
+
+/**
+ * Read a 64 bit little endian integer
+ * @param file The file to read from
+ * @param value Filled with the value read
+ * @return true if all 8 bytes could be read
+ */
+bool read_uint64(FILE *file, uint64_t *value);
+
+/**
+ * Write the header that comes before the cells of a maze file
+ * @param file The file to write to
+ * @param width The width of the maze
+ * @param height The height of the maze
+ * @param seed The seed the maze was generated with
+ */
+void write_maze_header(FILE *file, uint64_t width, uint64_t height, uint64_t seed);
+
+/**
+ * A row sink that writes each row straight to a file, data is the FILE.
+ * @return 0 if the row was written
+ */
+int file_row_sink(void *data, const unsigned char *cells, size_t width);
+
+/**
+ * Generate a maze a row at a time straight into a file, so the maze never
+ * has to fit in memory. The file can be read back with read_maze as long as
+ * the dimensions are within MAX_MAZE_DIMENSION.
+ * @param file The file to write to
+ * @param width The width of the maze
+ * @param height The height of the maze
+ * @param generator The row streaming generator
+ * @param context The generator context, reseeded with seed
+ * @param seed The seed to generate with
+ * @return 0 if successful
+ */
+int stream_maze_to_file(
+        FILE *file, int width, uint64_t height,
+        RowGenerator generator, GeneratorContext *context, uint64_t seed
+);
+
 int write_maze(FILE *file, const Maze *maze) {
     if (file == NULL) {
         fprintf(stderr, "No file provided to write to");
@@ -49,24 +100,60 @@ int write_maze(FILE *file, const Maze *maze) {
     const int width = maze->width;
     const int height = maze->height;
 
+    write_maze_header(file, (uint64_t) width, (uint64_t) height, maze->seed);
+
+    // the grid is already in the packed format, just skip the border
+    unsigned char cells[256];
+    for (int y = 0; y < height; y++) {
+        if (maze->layout == LAYOUT_ROW_MAJOR) {
+            fwrite(maze->grid + index_at(maze, 0, y), 1, (size_t) width, file);
+            continue;
+        }
+        for (int x = 0; x < width; x += (int) sizeof(cells)) {
+            size_t count = (size_t) (width - x) < sizeof(cells) ? (size_t) (width - x) : sizeof(cells);
+            read_row_cells(maze, x, y, cells, count);
+            fwrite(cells, 1, count, file);
+        }
+    }
+    return fflush(file);
+}
+
+void write_maze_header(FILE *file, uint64_t width, uint64_t height, uint64_t seed) {
     // pack the maze into a small format
 
     // Format will be:
-    // MAZE (in ASCII)
-    // width integer
-    // height integer
-    // maze data
-    fputs("MAZE", file);
-    putw(width, file);
-    putw(height, file);
+    // MZSD (in ASCII)
+    // width 64 bit little endian integer
+    // height 64 bit little endian integer
+    // seed 64 bit little endian integer
+    // maze data, a byte per cell a row at a time
+    fputs("MZSD", file);
+    write_uint64(file, width);
+    write_uint64(file, height);
+    write_uint64(file, seed);
+}
 
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            Cell *cell = cell_at(maze, x, y);
-            unsigned char packed_dirs = pack_cell(cell);
-            putc(packed_dirs, file);
-        }
+int file_row_sink(void *data, const unsigned char *cells, size_t width) {
+    FILE *file = data;
+    return fwrite(cells, 1, width, file) == width ? 0 : 1;
+}
+
+int stream_maze_to_file(
+        FILE *file, int width, uint64_t height,
+        RowGenerator generator, GeneratorContext *context, uint64_t seed
+) {
+    if (file == NULL) {
+        fprintf(stderr, "No file provided to write to");
+        exit(EXIT_FAILURE);
+    }
+    if (context == NULL) {
+        fprintf(stderr, "No context given to generator");
+        exit(EXIT_FAILURE);
     }
+    seed_random(&context->random, seed);
+    write_maze_header(file, (uint64_t) width, height, seed);
+    int result = generator(width, height, context, file_row_sink, file);
+    if (result != 0) return result;
     return fflush(file);
 }
 
@@ -86,6 +173,23 @@ unsigned char pack_cell(const Cell *cell) {
     return packed;
 }
 
+void write_uint64(FILE *file, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        putc((int) ((value >> (i * 8)) & 0xFFu), file);
+    }
+}
+
+bool read_uint64(FILE *file, uint64_t *value) {
+    uint64_t result = 0;
+    for (int i = 0; i < 8; i++) {
+        int c = fgetc(file);
+        if (c == EOF) return false;
+        result |= (uint64_t) c << (i * 8);
+    }
+    *value = result;
+    return true;
+}
+
 Maze *read_maze(FILE *file) {
     if (file == NULL) return NULL;
 
@@ -100,53 +204,84 @@ Maze *read_maze(FILE *file) {
         magic[i] = (char) c;
     }
     magic[4] = 0;
-    if (strcmp(magic, "MAZE") != 0) {
-        fprintf(stderr, "Not a valid maze file\n");
-        return NULL;
-    }
 
     // Get dimensions
-    int width;
-    int height;
-    if (fread(&width, sizeof(int), 1, file) != 1) {
-        fprintf(stderr, "Could not read width\n");
+    uint64_t width;
+    uint64_t height;
+    uint64_t seed = 0;
+    bool has_seed = strcmp(magic, "MZSD") == 0;
+    if (has_seed || strcmp(magic, "MZ64") == 0) {
+        if (!read_uint64(file, &width)) {
+            fprintf(stderr, "Could not read width\n");
+            return NULL;
+        }
+        if (!read_uint64(file, &height)) {
+            fprintf(stderr, "Could not read height\n");
+            return NULL;
+        }
+        if (has_seed && !read_uint64(file, &seed)) {
+            fprintf(stderr, "Could not read seed\n");
+            return NULL;
+        }
+    } else if (strcmp(magic, "MAZE") == 0) {
+        // older format with native int dimensions
+        int old_width;
+        int old_height;
+        if (fread(&old_width, sizeof(int), 1, file) != 1) {
+            fprintf(stderr, "Could not read width\n");
+            return NULL;
+        }
+        if (fread(&old_height, sizeof(int), 1, file) != 1) {
+            fprintf(stderr, "Could not read height\n");
+            return NULL;
+        }
+        width = old_width < 0 ? 0 : (uint64_t) old_width;
+        height = old_height < 0 ? 0 : (uint64_t) old_height;
+    } else {
+        fprintf(stderr, "Not a valid maze file\n");
         return NULL;
     }
-    if (fread(&height, sizeof(int), 1, file) != 1) {
-        fprintf(stderr, "Could not read height\n");
+    if (width == 0 || height == 0 || width > MAX_MAZE_DIMENSION || height > MAX_MAZE_DIMENSION) {
+        fprintf(stderr, "Unsupported maze dimensions %llux%llu\n",
+                (unsigned long long) width, (unsigned long long) height);
         return NULL;
     }
 
     // Load maze
-    Maze *maze = new_maze(width, height, false);
-    const int size = width * height;
+    Maze *maze = new_maze((int) width, (int) height, false);
+    maze->seed = seed;
 
-    for (int i = 0; i < size; i++) {
-        unsigned char byte = fgetc(file);
-        if (feof(file) != 0) {
-            fprintf(stderr, "missing cells in file %d/%d", i, size);
-            break;
-        }
-        bool north, east, south, west, delete;
-        north = byte & 1u;
-        east = byte & 2u;
-        south = byte & 4u;
-        west = byte & 8u;
-        delete = byte & 16u;
-
-        int x = i % width;
-        int y = i / width;
-        if (delete) {
-            remove_cell(maze, x, y);
-            continue;
-        }
+    for (int y = 0; y < (int) height; y++) {
+        for (int x = 0; x < (int) width; x++) {
+            int c = fgetc(file);
+            if (c == EOF) {
+                fprintf(stderr, "missing cells in file %d,%d", x, y);
+                return maze;
+            }
+            unsigned char byte = (unsigned char) c;
+            bool north, east, south, west, delete;
+            north = byte & 1u;
+            east = byte & 2u;
+            south = byte & 4u;
+            west = byte & 8u;
+            delete = byte & 16u;
+
+            if (delete) {
+                remove_cell(maze, x, y);
+                continue;
+            }
 
-        Cell *cell = cell_at(maze, x, y);
-        if (cell == NULL) continue;
-        if (north) link_cell_in_dir(maze, cell, NORTH);
-        if (east) link_cell_in_dir(maze, cell, EAST);
-        if (south) link_cell_in_dir(maze, cell, SOUTH);
-        if (west) link_cell_in_dir(maze, cell, WEST);
+            size_t index = index_at(maze, x, y);
+            if (!index_in_maze(maze, index)) continue;
+            if (north) link_index_in_dir(maze, index, NORTH);
+            if (east) link_index_in_dir(maze, index, EAST);
+            if (south) link_index_in_dir(maze, index, SOUTH);
+            if (west) link_index_in_dir(maze, index, WEST);
+
+            // walls opened to the outside, like an entrance or exit, have no
+            // cell to link to so are set directly
+            maze->grid[index] |= byte & get_edge_mask(maze, x, y);
+        }
     }
 
     return maze;
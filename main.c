@@ -8,9 +8,121 @@
 #include "generator/BSP.h"
 #include "generator/example.h"
 #include "generator/Kruskal.h"
+#include "generator/Wilson.h"
+#include "generator/Eller.h"
+#include "generator/Backtracker.h"
+#include "generator/Prim.h"
+#include "generator/GrowingTree.h"
+#include "io.h"
+#include "Batch.h"
 #include "SDL_Maze_Renderer.h"
 
-int main(int argc, char **args) {
+int main(int argc, char **all_args) {
+
+    // pull out the options, leaving the positional arguments in args
+    uint64_t seed = (uint64_t) time(NULL);
+    char *stream_path = NULL;
+    int tile_size = 0;
+    long long batch_count = -1;
+    char *batch_directory = NULL;
+    int thread_count = available_threads();
+    int diameter_flags = 0;
+    enum MazeLayout layout = LAYOUT_ROW_MAJOR;
+    char **args = malloc(sizeof(char *) * argc);
+    if (args == NULL) {
+        fprintf(stderr, "Unable to allocate arguments\n");
+        return EXIT_FAILURE;
+    }
+    int count = 0;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(all_args[i], "--seed") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--seed needs a value\n");
+                free(args);
+                return EXIT_FAILURE;
+            }
+            char *end;
+            seed = strtoull(all_args[++i], &end, 10);
+            if (*end != '\0') {
+                fprintf(stderr, "seed must be a number, was %s\n", all_args[i]);
+                free(args);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(all_args[i], "--tile") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--tile needs a size\n");
+                free(args);
+                return EXIT_FAILURE;
+            }
+            char *end;
+            long size = strtol(all_args[++i], &end, 10);
+            if (*end != '\0' || size < 1 || size > MAX_MAZE_DIMENSION) {
+                fprintf(stderr, "tile size must be between 1 and %d, was %s\n", MAX_MAZE_DIMENSION, all_args[i]);
+                free(args);
+                return EXIT_FAILURE;
+            }
+            tile_size = (int) size;
+        } else if (strcmp(all_args[i], "--count") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--count needs a value\n");
+                free(args);
+                return EXIT_FAILURE;
+            }
+            char *end;
+            batch_count = strtoll(all_args[++i], &end, 10);
+            if (*end != '\0' || batch_count < 0) {
+                fprintf(stderr, "count must be a positive number, was %s\n", all_args[i]);
+                free(args);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(all_args[i], "--out") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--out needs a directory\n");
+                free(args);
+                return EXIT_FAILURE;
+            }
+            batch_directory = all_args[++i];
+        } else if (strcmp(all_args[i], "--threads") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--threads needs a value\n");
+                free(args);
+                return EXIT_FAILURE;
+            }
+            char *end;
+            long threads = strtol(all_args[++i], &end, 10);
+            if (*end != '\0' || threads < 1 || threads > MAX_PARALLEL_THREADS) {
+                fprintf(stderr, "threads must be between 1 and %d, was %s\n", MAX_PARALLEL_THREADS, all_args[i]);
+                free(args);
+                return EXIT_FAILURE;
+            }
+            thread_count = (int) threads;
+        } else if (strcmp(all_args[i], "--layout") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--layout needs a layout\n");
+                free(args);
+                return EXIT_FAILURE;
+            }
+            if (!maze_layout_from_name(all_args[++i], &layout)) {
+                fprintf(stderr, "layout must be row or tiled, was %s\n", all_args[i]);
+                free(args);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(all_args[i], "--diameter") == 0) {
+            diameter_flags |= DIAMETER_PRINT;
+        } else if (strcmp(all_args[i], "--open-ends") == 0) {
+            diameter_flags |= DIAMETER_OPEN_ENDS;
+        } else if (strcmp(all_args[i], "--stream") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--stream needs a file\n");
+                free(args);
+                return EXIT_FAILURE;
+            }
+            stream_path = all_args[++i];
+        } else {
+            args[count++] = all_args[i];
+        }
+    }
+    argc = count;
 
     if (argc < 3) {
         fprintf(stderr, "Missing width and height arguments\n");
@@ -18,22 +130,66 @@ int main(int argc, char **args) {
         fprintf(stderr, "arg2 is height (required)\n");
         fprintf(stderr, "arg3 is algorithm (optional)\n");
         fprintf(stderr, "arg4 is cell-size (optional)\n");
+        fprintf(stderr, "--seed N sets the random seed (optional)\n");
+        fprintf(stderr, "--stream FILE writes the maze to FILE a row at a time (optional)\n");
+        fprintf(stderr, "--tile N generates the maze in N by N tiles at the same time (optional)\n");
+        fprintf(stderr, "--count N --out DIR writes N mazes to DIR without showing them (optional)\n");
+        fprintf(stderr, "--threads T sets how many threads --count uses (optional)\n");
+        fprintf(stderr, "--layout row|tiled sets how the grid is stored in memory (optional)\n");
+        fprintf(stderr, "--diameter prints the longest path through each maze (optional)\n");
+        fprintf(stderr, "--open-ends opens the outer walls at the ends of the longest path (optional)\n");
+        free(args);
         return EXIT_FAILURE;
     }
 
-    const int width = (int) strtol(args[1], NULL, 10);
-    const int height = (int) strtol(args[2], NULL, 10);
+    char *width_end, *height_end;
+    const long long width = strtoll(args[1], &width_end, 10);
+    const long long height = strtoll(args[2], &height_end, 10);
 
-    if (width < 0) {
-        fprintf(stderr, "width must be greater than 0, was %d\n", width);
+    if (*width_end != '\0' || width <= 0 || width > MAX_MAZE_DIMENSION) {
+        fprintf(stderr, "width must be between 1 and %d, was %s\n", MAX_MAZE_DIMENSION, args[1]);
+        free(args);
         return EXIT_FAILURE;
     }
-    if (height < 0) {
-        fprintf(stderr, "height must be greater than 0, was %d\n", height);
+    if (stream_path != NULL) {
+        // only a row is kept in memory so the height can be anything
+        char *end;
+        uint64_t stream_height = strtoull(args[2], &end, 10);
+        if (*end != '\0' || stream_height == 0) {
+            fprintf(stderr, "height must be a positive number, was %s\n", args[2]);
+            free(args);
+            return EXIT_FAILURE;
+        }
+        if (argc >= 4 && strcmp(args[3], "eller") != 0) {
+            fprintf(stderr, "Only eller can be streamed, not %s\n", args[3]);
+            free(args);
+            return EXIT_FAILURE;
+        }
+        FILE *file = fopen(stream_path, "wb");
+        if (file == NULL) {
+            fprintf(stderr, "Unable to open %s\n", stream_path);
+            free(args);
+            return EXIT_FAILURE;
+        }
+        GeneratorContext *context = new_generator_context(seed);
+        printf("Seed: %llu\n", (unsigned long long) seed);
+        int result = stream_maze_to_file(file, (int) width, stream_height, stream_eller_maze, context, seed);
+        delete_generator_context(context);
+        if (fclose(file) != 0 || result != 0) {
+            fprintf(stderr, "Failed writing to %s\n", stream_path);
+            free(args);
+            return EXIT_FAILURE;
+        }
+        free(args);
+        return 0;
+    }
+    if (*height_end != '\0' || height <= 0 || height > MAX_MAZE_DIMENSION) {
+        fprintf(stderr, "height must be between 1 and %d, was %s\n", MAX_MAZE_DIMENSION, args[2]);
+        free(args);
         return EXIT_FAILURE;
     }
 
-    void (*algorithm)(const Maze *);
+    void (*algorithm)(const Maze *, GeneratorContext *);
     if (argc >= 4) {
         char *name = args[3];
         if (strcmp(name, "aldous") == 0) {
@@ -50,32 +206,71 @@ int main(int argc, char **args) {
             algorithm = generate_example_maze;
         } else if(strcmp(name, "kruskal") == 0) {
             algorithm = generate_kruskal_maze;
+        } else if (strcmp(name, "wilson") == 0) {
+            algorithm = generate_wilson_maze;
+        } else if (strcmp(name, "eller") == 0) {
+            algorithm = generate_eller_maze;
+        } else if (strcmp(name, "backtracker") == 0) {
+            algorithm = generate_backtracker_maze;
+        } else if (strcmp(name, "prim") == 0) {
+            algorithm = generate_prim_maze;
+        } else if (strncmp(name, "growingtree:", 12) == 0 && growing_tree_generator(name + 12) != NULL) {
+            algorithm = growing_tree_generator(name + 12);
         } else {
             fprintf(stderr, "Unknown algorithm: %s\n", name);
             fprintf(
                     stderr,
-                    "Valid algorithms are:\naldous,hunt,sidewinder,binary,bsp,example,kruskal\n"
+                    "Valid algorithms are:\naldous,hunt,sidewinder,binary,bsp,example,kruskal,wilson,eller,backtracker,prim,\n"
+                    "growingtree:newest,growingtree:random,growingtree:oldest,growingtree:mix\n"
             );
+            free(args);
             return EXIT_FAILURE;
         }
     } else {
         algorithm = generate_hunt_and_kill_maze;
     }
 
+    if (batch_count >= 0 || batch_directory != NULL) {
+        if (batch_count < 0 || batch_directory == NULL) {
+            fprintf(stderr, "--count and --out must be used together\n");
+            free(args);
+            return EXIT_FAILURE;
+        }
+        printf("Seed: %llu\n", (unsigned long long) seed);
+        struct timespec started, finished;
+        timespec_get(&started, TIME_UTC);
+        int result = generate_maze_batch(
+                (int) width, (int) height, layout, algorithm, tile_size,
+                (size_t) batch_count, batch_directory, seed, thread_count, diameter_flags
+        );
+        timespec_get(&finished, TIME_UTC);
+        double seconds = (double) (finished.tv_sec - started.tv_sec)
+                         + (double) (finished.tv_nsec - started.tv_nsec) / 1e9;
+        if (seconds <= 0) seconds = 1e-9;
+        double cells = (double) batch_count * (double) width * (double) height;
+        printf("Generated %lld mazes in %.3fs on %d threads\n", batch_count, seconds, thread_count);
+        printf("%.1f mazes/s, %.0f cells/s\n", (double) batch_count / seconds, cells / seconds);
+        free(args);
+        return result == 0 ? 0 : EXIT_FAILURE;
+    }
+
     int cell_size;
     if (argc >= 5) {
-        cell_size = (int) strtol(args[4], NULL, 10);
-        if (cell_size < 3) {
+        char *end;
+        long size = strtol(args[4], &end, 10);
+        if (*end != '\0' || size < 3 || size > INT_MAX) {
             fprintf(stderr, "cell-size must be 3+\n");
+            free(args);
             return EXIT_FAILURE;
         }
+        cell_size = (int) size;
     } else {
         cell_size = 10;
     }
 
-    srand(time(NULL));
-    Maze *maze = new_maze(width, height, false);
-    render_maze_with_refresh(maze, cell_size, algorithm);
+    Maze *maze = new_maze_with_layout((int) width, (int) height, false, layout);
+    render_maze_with_refresh(maze, cell_size, algorithm, seed, tile_size, diameter_flags);
     delete_maze(maze);
+    free(args);
     return 0;
 }
@@ -0,0 +1,421 @@
+#ifndef MAZE_DIAMETER_H
+#define MAZE_DIAMETER_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "../Maze.h"
+#include "../GeneratorContext.h"
+#include "../Parallel.h"
+
+// levels with at least this many cells are shared out between threads,
+// smaller ones are quicker on the calling thread than starting any
+#define DIAMETER_PARALLEL_CELLS ((size_t) 1 << 12)
+
+// the most cells a cell other than the source can add to the next level, as
+// it was reached from one of it's neighbours
+#define DIAMETER_FAN_OUT (DIRECTION_COUNT - 1)
+
+// flags for report_maze_diameter
+#define DIAMETER_PRINT 1
+#define DIAMETER_OPEN_ENDS 2
+
+/**
+ * The longest path through a maze.
+ */
+typedef struct {
+    // the grid index at each end
+    size_t start;
+    size_t end;
+    // the number of steps between them
+    uint64_t length;
+} MazeDiameter;
+
+/**
+ * Finds the longest paths through mazes.
+ *
+ * The buffers only grow, so a solver used over and over on mazes of the same
+ * size only allocates the first time.
+ */
+typedef struct {
+    // a bit per grid index, set once a sweep has reached it
+    _Atomic uint64_t *visited;
+    size_t visited_words;
+    // the cells of the current level of a sweep and the ones found for the
+    // next, both hold capacity entries
+    size_t *level;
+    size_t *next;
+    size_t capacity;
+} DiameterSolver;
+
+/**
+ * One level of a breadth first sweep, split into blocks that each write the
+ * cells they find to their own part of next.
+ */
+typedef struct {
+    const Maze *maze;
+    _Atomic uint64_t *visited;
+    const size_t *level;
+    size_t count;
+    size_t block_size;
+    size_t *next;
+    size_t *next_counts;
+} DiameterLevel;
+
+MazeDiameter diameter_between(DiameterSolver *solver, const Maze *maze, size_t first, int thread_count, bool edges);
+
+size_t diameter_sweep(
+        DiameterSolver *solver, const Maze *maze, size_t source, int thread_count, bool edges, uint64_t *length
+);
+
+size_t diameter_expand(
+        const Maze *maze, _Atomic uint64_t *visited, bool shared,
+        const size_t *level, size_t first, size_t last, size_t *found
+);
+
+void diameter_level_task(void *data, size_t start, size_t end);
+
+void reserve_diameter_levels(DiameterSolver *solver, size_t count);
+
+bool on_maze_edge(const Maze *maze, size_t index);
+
+DiameterSolver *new_diameter_solver() {
+    DiameterSolver *solver = malloc(sizeof(DiameterSolver));
+    if (solver == NULL) {
+        fprintf(stderr, "Unable to allocate diameter solver");
+        exit(EXIT_FAILURE);
+    }
+    solver->visited = NULL;
+    solver->visited_words = 0;
+    solver->level = NULL;
+    solver->next = NULL;
+    solver->capacity = 0;
+    return solver;
+}
+
+void delete_diameter_solver(DiameterSolver *solver) {
+    if (solver == NULL) return;
+    free(solver->visited);
+    free(solver->level);
+    free(solver->next);
+    free(solver);
+}
+
+/**
+ * Find the longest path through a maze.
+ *
+ * A perfect maze is a tree, so the cell farthest from any cell is one end of
+ * the longest path and the cell farthest from that is the other end. That
+ * takes two breadth first sweeps. Each sweep goes a level at a time and big
+ * levels are shared out between threads, with cells claimed in an atomic
+ * visited bitset so mazes with loops work too, although for those the result
+ * is only a long path rather than the longest.
+ *
+ * Only the part of the maze reachable from it's first cell is looked at.
+ * Where there is a tie the end with the lowest grid index is picked, so the
+ * result does not depend on the thread count.
+ * @param solver The solver to use the buffers of
+ * @param maze The maze
+ * @param thread_count The most threads to use
+ * @return The ends and length of the longest path
+ */
+MazeDiameter maze_diameter(DiameterSolver *solver, const Maze *maze, int thread_count) {
+    if (solver == NULL || maze == NULL) {
+        fprintf(stderr, "No diameter solver or maze given to solver");
+        exit(EXIT_FAILURE);
+    }
+    MazeDiameter diameter = {0, 0, 0};
+    if (maze->cell_count == 0) return diameter;
+
+    for (int y = 0; y < maze->height; y++) {
+        size_t index = index_at(maze, 0, y);
+        for (int x = 0; x < maze->width; x++, index = get_index_adjacent(maze, index, EAST)) {
+            if (index_in_maze(maze, index)) return diameter_between(solver, maze, index, thread_count, false);
+        }
+    }
+    return diameter;
+}
+
+/**
+ * Find the longest path between two cells on the edge of a maze, the ones
+ * that can have an opening to the outside.
+ *
+ * The same two sweeps as maze_diameter find it, each starting from a cell on
+ * the edge and ending at the farthest cell on the edge, which still gives
+ * the longest such path in a perfect maze.
+ * @param solver The solver to use the buffers of
+ * @param maze The maze
+ * @param thread_count The most threads to use
+ * @param diameter Set to the ends and length of the path
+ * @return false if there are no cells on the edge of the maze
+ */
+bool maze_edge_diameter(DiameterSolver *solver, const Maze *maze, int thread_count, MazeDiameter *diameter) {
+    if (solver == NULL || maze == NULL) {
+        fprintf(stderr, "No diameter solver or maze given to solver");
+        exit(EXIT_FAILURE);
+    }
+    const int width = maze->width;
+    const int height = maze->height;
+    for (int y = 0; y < height; y++) {
+        // between the top and bottom rows only the first and last cells
+        int step = y == 0 || y == height - 1 || width < 2 ? 1 : width - 1;
+        for (int x = 0; x < width; x += step) {
+            size_t index = index_at(maze, x, y);
+            if (!index_in_maze(maze, index)) continue;
+            *diameter = diameter_between(solver, maze, index, thread_count, true);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * The two sweeps of maze_diameter from a given cell.
+ * @param solver The solver
+ * @param maze The maze
+ * @param first The grid index of the cell to start from
+ * @param thread_count The most threads to use
+ * @param edges Only end at cells on the edge of the maze, first must be one
+ * @return The ends and length of the longest path
+ */
+MazeDiameter diameter_between(DiameterSolver *solver, const Maze *maze, size_t first, int thread_count, bool edges) {
+    const size_t words = (maze->grid_size + 63) / 64;
+    solver->visited = reserve_generator_buffer(
+            solver->visited, &solver->visited_words, words, sizeof(_Atomic uint64_t)
+    );
+    reserve_diameter_levels(solver, DIRECTION_COUNT);
+
+    MazeDiameter diameter;
+    for (size_t i = 0; i < words; i++) atomic_init(&solver->visited[i], 0);
+    diameter.start = diameter_sweep(solver, maze, first, thread_count, edges, &diameter.length);
+    for (size_t i = 0; i < words; i++) atomic_init(&solver->visited[i], 0);
+    diameter.end = diameter_sweep(solver, maze, diameter.start, thread_count, edges, &diameter.length);
+    return diameter;
+}
+
+/**
+ * Grow the level buffers of a solver to hold at least count entries.
+ * @param solver The solver
+ * @param count The entries needed
+ */
+void reserve_diameter_levels(DiameterSolver *solver, size_t count) {
+    if (count <= solver->capacity) return;
+    // levels tend to grow a bit at a time, so grow by at least half again
+    size_t capacity = solver->capacity + solver->capacity / 2;
+    if (capacity < count) capacity = count;
+    size_t level_capacity = solver->capacity;
+    solver->level = reserve_generator_buffer(solver->level, &level_capacity, capacity, sizeof(size_t));
+    solver->next = reserve_generator_buffer(solver->next, &solver->capacity, capacity, sizeof(size_t));
+}
+
+/**
+ * @param maze The maze
+ * @param index The grid index of a cell in the maze
+ * @return If the cell is on the edge of the maze grid
+ */
+bool on_maze_edge(const Maze *maze, size_t index) {
+    return get_edge_mask(maze, index_x(maze, index), index_y(maze, index)) != 0;
+}
+
+/**
+ * Sweep out from a cell a level at a time.
+ * @param solver The solver, it's visited bits must be clear
+ * @param maze The maze
+ * @param source The grid index to start from
+ * @param thread_count The most threads to use
+ * @param edges Only count cells on the edge of the maze as the farthest
+ * @param length Set to the distance to the farthest cell
+ * @return The farthest cell from the source with the lowest grid index
+ */
+size_t diameter_sweep(
+        DiameterSolver *solver, const Maze *maze, size_t source, int thread_count, bool edges, uint64_t *length
+) {
+    _Atomic uint64_t *visited = solver->visited;
+    atomic_fetch_or(&visited[source / 64], (uint64_t) 1 << (source % 64));
+    solver->level[0] = source;
+    size_t count = 1;
+    uint64_t distance = 0;
+    size_t farthest = source;
+    uint64_t farthest_distance = 0;
+
+    for (;;) {
+        int threads = count >= DIAMETER_PARALLEL_CELLS ? thread_count : 1;
+        if (threads > MAX_PARALLEL_THREADS) threads = MAX_PARALLEL_THREADS;
+        size_t next_count = 0;
+
+        if (threads <= 1) {
+            // at most every cell left, which is fewer than count times the
+            // fan out near the end of a sweep
+            size_t needed = count == 1 ? DIRECTION_COUNT : checked_size_multiply(count, DIAMETER_FAN_OUT);
+            if (needed > maze->cell_count) needed = maze->cell_count;
+            reserve_diameter_levels(solver, needed);
+            next_count = diameter_expand(maze, visited, false, solver->level, 0, count, solver->next);
+        } else {
+            size_t blocks = (size_t) threads * 8;
+            size_t block_size = (count + blocks - 1) / blocks;
+            blocks = (count + block_size - 1) / block_size;
+            reserve_diameter_levels(solver, checked_size_multiply(blocks * block_size, DIAMETER_FAN_OUT));
+            size_t next_counts[MAX_PARALLEL_THREADS * 8];
+
+            DiameterLevel task;
+            task.maze = maze;
+            task.visited = visited;
+            task.level = solver->level;
+            task.count = count;
+            task.block_size = block_size;
+            task.next = solver->next;
+            task.next_counts = next_counts;
+            run_parallel(threads, blocks, diameter_level_task, &task);
+
+            // pack the blocks together
+            for (size_t block = 0; block < blocks; block++) {
+                memmove(solver->next + next_count, solver->next + block * block_size * DIAMETER_FAN_OUT,
+                        next_counts[block] * sizeof(size_t));
+                next_count += next_counts[block];
+            }
+        }
+
+        if (edges && distance > 0) {
+            // the last level with a cell on the edge, the source is one
+            bool found = false;
+            size_t lowest = 0;
+            for (size_t i = 0; i < count; i++) {
+                size_t index = solver->level[i];
+                if ((!found || index < lowest) && on_maze_edge(maze, index)) {
+                    lowest = index;
+                    found = true;
+                }
+            }
+            if (found) {
+                farthest = lowest;
+                farthest_distance = distance;
+            }
+        }
+        if (next_count == 0) break;
+
+        size_t *swap = solver->level;
+        solver->level = solver->next;
+        solver->next = swap;
+        count = next_count;
+        distance++;
+    }
+
+    if (!edges) {
+        farthest = solver->level[0];
+        for (size_t i = 1; i < count; i++) {
+            if (solver->level[i] < farthest) farthest = solver->level[i];
+        }
+        farthest_distance = distance;
+    }
+    *length = farthest_distance;
+    return farthest;
+}
+
+/**
+ * Find the cells of the next level reached from part of a level.
+ * @param maze The maze
+ * @param visited The visited bit of each grid index, found cells are set
+ * @param shared If other threads are using visited at the same time
+ * @param level The level
+ * @param first The first position in level to look at
+ * @param last The position in level to stop at
+ * @param found Filled with the cells not visited before
+ * @return The number of cells found
+ */
+size_t diameter_expand(
+        const Maze *maze, _Atomic uint64_t *visited, bool shared,
+        const size_t *level, size_t first, size_t last, size_t *found
+) {
+    size_t found_count = 0;
+    for (size_t i = first; i < last; i++) {
+        size_t index = level[i];
+        unsigned int walls = get_open_walls(maze, index);
+        while (walls != 0) {
+            int dir = count_trailing_zeros(walls);
+            walls &= walls - 1;
+            size_t adjacent = get_index_adjacent(maze, index, dir);
+            uint64_t bit = (uint64_t) 1 << (adjacent % 64);
+            _Atomic uint64_t *word = &visited[adjacent / 64];
+            // check before claiming, most cells seen are the one we came from
+            uint64_t bits = atomic_load_explicit(word, memory_order_relaxed);
+            if (bits & bit) continue;
+            if (shared) {
+                if (atomic_fetch_or_explicit(word, bit, memory_order_relaxed) & bit) continue;
+            } else {
+                atomic_store_explicit(word, bits | bit, memory_order_relaxed);
+            }
+            found[found_count++] = adjacent;
+        }
+    }
+    return found_count;
+}
+
+void diameter_level_task(void *data, size_t start, size_t end) {
+    const DiameterLevel *task = data;
+    for (size_t block = start; block < end; block++) {
+        size_t first = block * task->block_size;
+        size_t last = first + task->block_size < task->count ? first + task->block_size : task->count;
+        task->next_counts[block] = diameter_expand(
+                task->maze, task->visited, true, task->level, first, last,
+                task->next + first * DIAMETER_FAN_OUT
+        );
+    }
+}
+
+/**
+ * Open the wall of a cell on the edge of the maze grid to the outside.
+ *
+ * The open wall is written out by write_maze, read back by read_maze and
+ * drawn by the renderer. Solvers expect closed outer walls so they should
+ * be run first.
+ * @param maze The maze
+ * @param index The grid index of the cell
+ * @return false if the cell has no wall to the outside
+ */
+bool open_outer_wall(const Maze *maze, size_t index) {
+    if (!index_in_maze(maze, index)) return false;
+    // only the edge of the grid, not the side of a missing cell
+    unsigned int outside = get_edge_mask(maze, index_x(maze, index), index_y(maze, index));
+    if (outside == 0) return false;
+    maze->grid[index] |= DIRECTION_BIT(count_trailing_zeros(outside));
+    return true;
+}
+
+/**
+ * Find the longest path through a maze and act on it.
+ *
+ * When the ends are to be opened the path is the longest between two cells
+ * on the edge of the maze, as only they have an outer wall to open.
+ * @param solver The solver to use the buffers of
+ * @param maze The maze
+ * @param flags DIAMETER_PRINT to print it and DIAMETER_OPEN_ENDS to open the
+ * outer walls at the ends of it
+ * @param thread_count The most threads to use
+ * @param name What to call the maze when printing
+ * @return The ends and length of the longest path
+ */
+MazeDiameter report_maze_diameter(
+        DiameterSolver *solver, const Maze *maze, int flags, int thread_count, const char *name
+) {
+    MazeDiameter diameter;
+    bool open_ends = (flags & DIAMETER_OPEN_ENDS) != 0;
+    if (open_ends && !maze_edge_diameter(solver, maze, thread_count, &diameter)) {
+        fprintf(stderr, "%s has no cells on it's edge, no ends opened\n", name);
+        open_ends = false;
+    }
+    if (!open_ends) {
+        diameter = maze_diameter(solver, maze, thread_count);
+    }
+    if (flags & DIAMETER_PRINT) {
+        printf("%s diameter: %llu from %d,%d to %d,%d\n", name, (unsigned long long) diameter.length,
+               index_x(maze, diameter.start), index_y(maze, diameter.start),
+               index_x(maze, diameter.end), index_y(maze, diameter.end));
+    }
+    if (open_ends) {
+        if (!open_outer_wall(maze, diameter.start) || !open_outer_wall(maze, diameter.end)) {
+            fprintf(stderr, "%s: an end of the longest path has no outer wall to open\n", name);
+        }
+    }
+    return diameter;
+}
+
+#endif //MAZE_DIAMETER_H
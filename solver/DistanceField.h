@@ -0,0 +1,202 @@
+#ifndef MAZE_DISTANCEFIELD_H
+#define MAZE_DISTANCEFIELD_H
+
+#include <stdint.h>
+#include "../Maze.h"
+#include "../GeneratorContext.h"
+#include "../utils.h"
+
+// distance of a grid index the source cannot reach
+#define DISTANCE_UNREACHED UINT32_MAX
+
+// the smallest the queue starts at, always a power of 2
+#define DISTANCE_QUEUE_MIN 1024
+
+/**
+ * The distance from one cell to every other cell in a maze, along with the
+ * way back to it.
+ *
+ * The buffers only grow, so a field used over and over on the same maze only
+ * allocates the first time.
+ */
+typedef struct {
+    // steps from the source, one per grid index
+    uint32_t *distances;
+    size_t distance_capacity;
+    // the direction of the first step back towards the source, one per grid
+    // index, only valid for reached cells other than the source
+    unsigned char *parents;
+    size_t parent_capacity;
+    // ring buffer of grid indexes still to visit, the capacity is a power of 2
+    size_t *queue;
+    size_t queue_capacity;
+    // the grid index distances are measured from
+    size_t source;
+    // a reached grid index that is as far from the source as any other
+    size_t farthest;
+    // the number of cells the source can reach, including itself
+    size_t reached;
+} DistanceField;
+
+void grow_distance_queue(DistanceField *field, size_t head);
+
+DistanceField *new_distance_field() {
+    DistanceField *field = malloc(sizeof(DistanceField));
+    if (field == NULL) {
+        fprintf(stderr, "Unable to allocate distance field");
+        exit(EXIT_FAILURE);
+    }
+    field->distances = NULL;
+    field->distance_capacity = 0;
+    field->parents = NULL;
+    field->parent_capacity = 0;
+    field->queue = NULL;
+    field->queue_capacity = 0;
+    field->source = 0;
+    field->farthest = 0;
+    field->reached = 0;
+    return field;
+}
+
+void delete_distance_field(DistanceField *field) {
+    if (field == NULL) return;
+    free(field->distances);
+    free(field->parents);
+    free(field->queue);
+    free(field);
+}
+
+/**
+ * Work out the distance from a cell to every cell it can reach with a
+ * breadth first search.
+ *
+ * Everything is kept in flat arrays indexed by grid index and the cells to
+ * visit are in a ring buffer, which is only as big as the widest the search
+ * gets rather than the whole maze.
+ * @param field The distance field to fill
+ * @param maze The maze
+ * @param source The grid index of the cell to measure from
+ */
+void compute_distance_field(DistanceField *field, const Maze *maze, size_t source) {
+    if (field == NULL || maze == NULL) {
+        fprintf(stderr, "No distance field or maze given to solver");
+        exit(EXIT_FAILURE);
+    }
+    if (source >= maze->grid_size || !index_in_maze(maze, source)) {
+        fprintf(stderr, "Distance field source is not in the maze");
+        exit(EXIT_FAILURE);
+    }
+    if (maze->cell_count >= DISTANCE_UNREACHED) {
+        fprintf(stderr, "Too many cells for a distance field: %zu", maze->cell_count);
+        exit(EXIT_FAILURE);
+    }
+
+    const size_t grid_size = maze->grid_size;
+    field->distances = reserve_generator_buffer(
+            field->distances, &field->distance_capacity, grid_size, sizeof(uint32_t)
+    );
+    field->parents = reserve_generator_buffer(
+            field->parents, &field->parent_capacity, grid_size, sizeof(unsigned char)
+    );
+    if (field->queue_capacity < DISTANCE_QUEUE_MIN) {
+        field->queue = reserve_generator_buffer(
+                field->queue, &field->queue_capacity, DISTANCE_QUEUE_MIN, sizeof(size_t)
+        );
+    }
+    uint32_t *distances = field->distances;
+    unsigned char *parents = field->parents;
+    const unsigned char *grid = maze->grid;
+    // row major steps never need the slower path of get_index_adjacent
+    const bool row_major = maze->layout == LAYOUT_ROW_MAJOR;
+    memset(distances, 0xFF, grid_size * sizeof(uint32_t));
+
+    size_t *queue = field->queue;
+    size_t mask = field->queue_capacity - 1;
+    size_t head = 0;
+    size_t count = 1;
+    queue[0] = source;
+    distances[source] = 0;
+    size_t last = source;
+    size_t reached = 1;
+
+    while (count > 0) {
+        size_t index = queue[head];
+        head = (head + 1) & mask;
+        count--;
+        last = index;
+        uint32_t next_distance = distances[index] + 1;
+        unsigned int walls = grid[index] & OPEN_WALLS_MASK;
+        // the cell we came from is already reached
+        if (index != source) walls &= ~DIRECTION_BIT(parents[index]);
+        while (walls != 0) {
+            int dir = count_trailing_zeros(walls);
+            walls &= walls - 1;
+            size_t adjacent = row_major
+                              ? (size_t) ((ptrdiff_t) index + maze->steps[dir])
+                              : get_index_adjacent(maze, index, dir);
+            if (distances[adjacent] != DISTANCE_UNREACHED) continue;
+            distances[adjacent] = next_distance;
+            parents[adjacent] = (unsigned char) opposite_direction(dir);
+            reached++;
+            if (count == field->queue_capacity) {
+                grow_distance_queue(field, head);
+                queue = field->queue;
+                mask = field->queue_capacity - 1;
+            }
+            queue[(head + count) & mask] = adjacent;
+            count++;
+        }
+    }
+
+    field->source = source;
+    // the search visits cells in order of distance so the last is farthest
+    field->farthest = last;
+    field->reached = reached;
+}
+
+/**
+ * Double the size of a full queue, keeping the order of what is in it.
+ * @param field The distance field
+ * @param head Where the queue starts
+ */
+void grow_distance_queue(DistanceField *field, size_t head) {
+    const size_t capacity = field->queue_capacity;
+    field->queue = reserve_generator_buffer(
+            field->queue, &field->queue_capacity, checked_size_multiply(capacity, 2), sizeof(size_t)
+    );
+    // the entries before head wrapped around so move them after the rest
+    memcpy(field->queue + capacity, field->queue, head * sizeof(size_t));
+}
+
+/**
+ * @param field The distance field
+ * @param index A grid index
+ * @return The number of steps from the source or DISTANCE_UNREACHED
+ */
+uint32_t distance_to(const DistanceField *field, size_t index) {
+    return field->distances[index];
+}
+
+/**
+ * Find the path from the source to a cell by following the parents back.
+ * @param field The distance field
+ * @param maze The maze the field was computed for
+ * @param target The grid index to find the path to
+ * @param directions Filled with the direction of each step from the source,
+ * it must have room for distance_to(field, target) entries
+ * @return The number of steps, 0 if the target is the source or cannot be
+ * reached
+ */
+size_t distance_field_path(const DistanceField *field, const Maze *maze, size_t target, unsigned char *directions) {
+    uint32_t distance = field->distances[target];
+    if (distance == DISTANCE_UNREACHED) return 0;
+    size_t index = target;
+    for (size_t step = distance; step > 0; step--) {
+        int back = field->parents[index];
+        directions[step - 1] = (unsigned char) opposite_direction(back);
+        index = get_index_adjacent(maze, index, back);
+    }
+    return distance;
+}
+
+#endif //MAZE_DISTANCEFIELD_H
@@ -0,0 +1,387 @@
+#ifndef MAZE_PATHFINDER_H
+#define MAZE_PATHFINDER_H
+
+#include <stdint.h>
+#include "../Maze.h"
+#include "../GeneratorContext.h"
+#include "../utils.h"
+
+// directions packed into each byte of a path
+#define PATH_STEPS_PER_BYTE 4
+
+/**
+ * A path through a maze as the direction of each step, 2 bits each.
+ */
+typedef struct {
+    unsigned char *steps;
+    size_t capacity;
+    // the number of steps
+    size_t length;
+} MazePath;
+
+/**
+ * Finds paths between two cells of a maze.
+ *
+ * A cell counts as seen by a search when it's entry in epochs matches the
+ * epoch of that search. Each search moves the epoch on rather than clearing
+ * anything, so asking for path after path on a big maze only costs what each
+ * search visits. The buffers only grow so nothing is allocated once they are
+ * big enough.
+ */
+typedef struct {
+    // the epoch each grid index was last seen in
+    uint32_t *epochs;
+    size_t epoch_capacity;
+    // the epoch of the current search, the search from the goal of a
+    // bidirectional search uses the one after it
+    uint32_t epoch;
+    // steps from where the search that saw it started, per grid index
+    uint32_t *distances;
+    size_t distance_capacity;
+    // the direction back towards where the search started, per grid index
+    unsigned char *parents;
+    size_t parent_capacity;
+    // the cells still to visit, two queues for bidirectional search or two
+    // priority buckets for A*
+    size_t *lists[2];
+    size_t list_capacities[2];
+    // the last path found
+    MazePath path;
+} PathFinder;
+
+void begin_path_search(PathFinder *finder, const Maze *maze, size_t start, size_t goal);
+
+void push_to_path_list(PathFinder *finder, int list, size_t *count, size_t index);
+
+bool expand_path_level(
+        PathFinder *finder, const Maze *maze, int side, size_t *start, size_t *end,
+        size_t *meet_from, int *meet_dir, uint64_t *meet_length
+);
+
+void build_path(PathFinder *finder, const Maze *maze, size_t from, size_t total_length);
+
+PathFinder *new_path_finder() {
+    PathFinder *finder = malloc(sizeof(PathFinder));
+    if (finder == NULL) {
+        fprintf(stderr, "Unable to allocate path finder");
+        exit(EXIT_FAILURE);
+    }
+    finder->epochs = NULL;
+    finder->epoch_capacity = 0;
+    finder->epoch = 0;
+    finder->distances = NULL;
+    finder->distance_capacity = 0;
+    finder->parents = NULL;
+    finder->parent_capacity = 0;
+    for (int i = 0; i < 2; i++) {
+        finder->lists[i] = NULL;
+        finder->list_capacities[i] = 0;
+    }
+    finder->path.steps = NULL;
+    finder->path.capacity = 0;
+    finder->path.length = 0;
+    return finder;
+}
+
+void delete_path_finder(PathFinder *finder) {
+    if (finder == NULL) return;
+    free(finder->epochs);
+    free(finder->distances);
+    free(finder->parents);
+    free(finder->lists[0]);
+    free(finder->lists[1]);
+    free(finder->path.steps);
+    free(finder);
+}
+
+/**
+ * @param path The path
+ * @param step The step number, from 0
+ * @return The direction of the step
+ */
+int path_step(const MazePath *path, size_t step) {
+    unsigned int shift = (unsigned int) (step % PATH_STEPS_PER_BYTE) * 2u;
+    return (int) ((path->steps[step / PATH_STEPS_PER_BYTE] >> shift) & 3u);
+}
+
+/**
+ * @param path The path
+ * @param step The step number, from 0
+ * @param dir The direction of the step
+ */
+void set_path_step(MazePath *path, size_t step, int dir) {
+    unsigned int shift = (unsigned int) (step % PATH_STEPS_PER_BYTE) * 2u;
+    unsigned char *byte = path->steps + step / PATH_STEPS_PER_BYTE;
+    *byte = (unsigned char) ((*byte & ~(3u << shift)) | ((unsigned int) dir << shift));
+}
+
+/**
+ * Find a shortest path by searching from both ends at once, a level at a
+ * time from whichever end has the fewest cells waiting, until they meet.
+ * @param finder The path finder, finder->path is filled with the path
+ * @param maze The maze
+ * @param start The grid index to start from
+ * @param goal The grid index to get to
+ * @return false if there is no path
+ */
+bool find_path_bidirectional(PathFinder *finder, const Maze *maze, size_t start, size_t goal) {
+    begin_path_search(finder, maze, start, goal);
+    if (start == goal) return true;
+
+    size_t starts[2] = {0, 0};
+    size_t ends[2] = {1, 1};
+    finder->lists[0][0] = start;
+    finder->lists[1][0] = goal;
+    finder->epochs[goal] = finder->epoch + 1;
+    finder->distances[goal] = 0;
+
+    while (starts[0] < ends[0] && starts[1] < ends[1]) {
+        int side = ends[0] - starts[0] <= ends[1] - starts[1] ? 0 : 1;
+        size_t meet_from;
+        int meet_dir;
+        uint64_t meet_length;
+        if (expand_path_level(finder, maze, side, &starts[side], &ends[side], &meet_from, &meet_dir, &meet_length)) {
+            // put the halves together, the start half first
+            size_t meet_to = get_index_adjacent(maze, meet_from, meet_dir);
+            if (side == 1) {
+                size_t swap = meet_from;
+                meet_from = meet_to;
+                meet_to = swap;
+                meet_dir = opposite_direction(meet_dir);
+            }
+            build_path(finder, maze, meet_from, (size_t) meet_length);
+            size_t step = finder->distances[meet_from];
+            set_path_step(&finder->path, step++, meet_dir);
+            for (size_t index = meet_to; index != goal; step++) {
+                int dir = finder->parents[index];
+                set_path_step(&finder->path, step, dir);
+                index = get_index_adjacent(maze, index, dir);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Visit every cell in the next level of one side of a bidirectional search.
+ *
+ * The whole level is done even after the sides meet, as in a maze with loops
+ * a later cell in the level can give a shorter path.
+ * @param finder The path finder
+ * @param maze The maze
+ * @param side 0 for the search from the start or 1 for the goal
+ * @param start Where the level starts in the side's queue
+ * @param end Where the level ends in the side's queue
+ * @param meet_from Set to the cell on this side where the shortest meeting
+ * was found
+ * @param meet_dir Set to the direction from meet_from to the other side
+ * @param meet_length Set to the length of the path through the meeting
+ * @return true if the sides met
+ */
+bool expand_path_level(
+        PathFinder *finder, const Maze *maze, int side, size_t *start, size_t *end,
+        size_t *meet_from, int *meet_dir, uint64_t *meet_length
+) {
+    const uint32_t own = finder->epoch + (uint32_t) side;
+    const uint32_t other = finder->epoch + (uint32_t) (1 - side);
+    uint32_t *epochs = finder->epochs;
+    uint32_t *distances = finder->distances;
+    unsigned char *parents = finder->parents;
+    const unsigned char *grid = maze->grid;
+    bool met = false;
+    *meet_length = UINT64_MAX;
+
+    // move the level to the front so the queue never needs more room than
+    // two levels
+    size_t level = *end - *start;
+    size_t *queue = finder->lists[side];
+    memmove(queue, queue + *start, level * sizeof(size_t));
+    size_t count = level;
+
+    for (size_t i = 0; i < level; i++) {
+        size_t index = finder->lists[side][i];
+        unsigned int walls = grid[index] & OPEN_WALLS_MASK;
+        while (walls != 0) {
+            int dir = count_trailing_zeros(walls);
+            walls &= walls - 1;
+            size_t adjacent = get_index_adjacent(maze, index, dir);
+            if (epochs[adjacent] == other) {
+                uint64_t length = (uint64_t) distances[index] + distances[adjacent] + 1;
+                if (length < *meet_length) {
+                    *meet_length = length;
+                    *meet_from = index;
+                    *meet_dir = dir;
+                    met = true;
+                }
+                continue;
+            }
+            if (epochs[adjacent] == own) continue;
+            epochs[adjacent] = own;
+            distances[adjacent] = distances[index] + 1;
+            parents[adjacent] = (unsigned char) opposite_direction(dir);
+            push_to_path_list(finder, side, &count, adjacent);
+        }
+    }
+    *start = level;
+    *end = count;
+    return met;
+}
+
+/**
+ * Find a shortest path with A*, guided by the Manhattan distance to the goal.
+ *
+ * Each step changes the distance travelled plus the Manhattan distance left
+ * by 0 when it heads towards the goal or 2 when it heads away. So the
+ * priority queue only ever needs two buckets, the cells at the current
+ * priority and the cells 2 after it. Each bucket is a stack so the search
+ * keeps going along the newest cell when there is a tie.
+ * @param finder The path finder, finder->path is filled with the path
+ * @param maze The maze
+ * @param start The grid index to start from
+ * @param goal The grid index to get to
+ * @return false if there is no path
+ */
+bool find_path_astar(PathFinder *finder, const Maze *maze, size_t start, size_t goal) {
+    begin_path_search(finder, maze, start, goal);
+    if (start == goal) return true;
+
+    const uint32_t epoch = finder->epoch;
+    uint32_t *epochs = finder->epochs;
+    uint32_t *distances = finder->distances;
+    unsigned char *parents = finder->parents;
+    const unsigned char *grid = maze->grid;
+    const int goal_x = index_x(maze, goal);
+    const int goal_y = index_y(maze, goal);
+
+    size_t counts[2] = {1, 0};
+    int current = 0;
+    finder->lists[current][0] = start;
+    uint64_t priority = (uint64_t) abs(goal_x - index_x(maze, start)) + (uint64_t) abs(goal_y - index_y(maze, start));
+
+    while (counts[current] > 0) {
+        size_t index = finder->lists[current][--counts[current]];
+        int x = index_x(maze, index);
+        int y = index_y(maze, index);
+        uint64_t left = (uint64_t) abs(goal_x - x) + (uint64_t) abs(goal_y - y);
+        // a cell found again by a shorter path is left behind in a later
+        // bucket, skip it there
+        if ((uint64_t) distances[index] + left == priority) {
+            if (index == goal) {
+                build_path(finder, maze, goal, finder->distances[goal]);
+                return true;
+            }
+            // the directions that get closer to the goal
+            unsigned int closer = (goal_y < y ? DIRECTION_BIT(NORTH) : 0u)
+                                  | (goal_x > x ? DIRECTION_BIT(EAST) : 0u)
+                                  | (goal_y > y ? DIRECTION_BIT(SOUTH) : 0u)
+                                  | (goal_x < x ? DIRECTION_BIT(WEST) : 0u);
+            uint32_t distance = distances[index] + 1;
+            unsigned int walls = grid[index] & OPEN_WALLS_MASK;
+            while (walls != 0) {
+                int dir = count_trailing_zeros(walls);
+                walls &= walls - 1;
+                size_t adjacent = get_index_adjacent(maze, index, dir);
+                if (epochs[adjacent] == epoch && distances[adjacent] <= distance) continue;
+                epochs[adjacent] = epoch;
+                distances[adjacent] = distance;
+                parents[adjacent] = (unsigned char) opposite_direction(dir);
+                int bucket = (closer & DIRECTION_BIT(dir)) ? current : 1 - current;
+                push_to_path_list(finder, bucket, &counts[bucket], adjacent);
+            }
+        }
+        if (counts[current] == 0) {
+            current = 1 - current;
+            priority += 2;
+        }
+    }
+    return false;
+}
+
+/**
+ * Get the buffers ready and start a new epoch for a search.
+ * @param finder The path finder
+ * @param maze The maze
+ * @param start The grid index the search starts from
+ * @param goal The grid index the search is going to
+ */
+void begin_path_search(PathFinder *finder, const Maze *maze, size_t start, size_t goal) {
+    if (finder == NULL || maze == NULL) {
+        fprintf(stderr, "No path finder or maze given to solver");
+        exit(EXIT_FAILURE);
+    }
+    if (start >= maze->grid_size || goal >= maze->grid_size
+        || !index_in_maze(maze, start) || !index_in_maze(maze, goal)) {
+        fprintf(stderr, "Path start or goal is not in the maze");
+        exit(EXIT_FAILURE);
+    }
+    const size_t grid_size = maze->grid_size;
+    if (finder->epoch_capacity < grid_size || finder->epoch >= UINT32_MAX - 2) {
+        // new memory and worn out epochs both need a clean start
+        finder->epochs = reserve_generator_buffer(
+                finder->epochs, &finder->epoch_capacity, grid_size, sizeof(uint32_t)
+        );
+        memset(finder->epochs, 0, finder->epoch_capacity * sizeof(uint32_t));
+        finder->epoch = 0;
+    }
+    // each search uses two epochs, one for each side of a bidirectional one
+    finder->epoch += 2;
+    finder->distances = reserve_generator_buffer(
+            finder->distances, &finder->distance_capacity, grid_size, sizeof(uint32_t)
+    );
+    finder->parents = reserve_generator_buffer(
+            finder->parents, &finder->parent_capacity, grid_size, sizeof(unsigned char)
+    );
+    for (int i = 0; i < 2; i++) {
+        if (finder->list_capacities[i] < 64) {
+            finder->lists[i] = reserve_generator_buffer(
+                    finder->lists[i], &finder->list_capacities[i], 64, sizeof(size_t)
+            );
+        }
+    }
+    finder->path.length = 0;
+
+    finder->epochs[start] = finder->epoch;
+    finder->distances[start] = 0;
+}
+
+/**
+ * Add a grid index to the end of one of the lists, growing it if needed.
+ * @param finder The path finder
+ * @param list Which list
+ * @param count The number of entries in the list, moved on by one
+ * @param index The grid index
+ */
+void push_to_path_list(PathFinder *finder, int list, size_t *count, size_t index) {
+    if (*count == finder->list_capacities[list]) {
+        finder->lists[list] = reserve_generator_buffer(
+                finder->lists[list], &finder->list_capacities[list],
+                checked_size_multiply(*count, 2), sizeof(size_t)
+        );
+    }
+    finder->lists[list][(*count)++] = index;
+}
+
+/**
+ * Start finder->path with the steps from the start to a cell by following the
+ * parents back from it.
+ * @param finder The path finder
+ * @param maze The maze
+ * @param from The cell to find the path to, seen by the search from start
+ * @param total_length The length of the whole path, which can go on past from
+ */
+void build_path(PathFinder *finder, const Maze *maze, size_t from, size_t total_length) {
+    MazePath *path = &finder->path;
+    size_t bytes = total_length / PATH_STEPS_PER_BYTE + 1;
+    path->steps = reserve_generator_buffer(path->steps, &path->capacity, bytes, sizeof(unsigned char));
+    path->length = total_length;
+    size_t length = finder->distances[from];
+    size_t index = from;
+    for (size_t step = length; step > 0; step--) {
+        int back = finder->parents[index];
+        set_path_step(path, step - 1, opposite_direction(back));
+        index = get_index_adjacent(maze, index, back);
+    }
+}
+
+#endif //MAZE_PATHFINDER_H
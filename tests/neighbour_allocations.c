@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/**
+ * Checks that looking up neighbours and stepping a generator never touches
+ * the heap once its buffers have been made.
+ *
+ * malloc, calloc and realloc are counted by defining them over the ones in
+ * stdlib.h before the maze headers are included, so every call made from the
+ * headers goes through the counters below.
+ */
+
+static size_t allocations = 0;
+
+void *counting_malloc(size_t size) {
+    allocations++;
+    return malloc(size);
+}
+
+void *counting_calloc(size_t count, size_t size) {
+    allocations++;
+    return calloc(count, size);
+}
+
+void *counting_realloc(void *pointer, size_t size) {
+    allocations++;
+    return realloc(pointer, size);
+}
+
+#define malloc counting_malloc
+#define calloc counting_calloc
+#define realloc counting_realloc
+
+#include "../Maze.h"
+#include "../utils.h"
+#include "../generator/HuntKill.h"
+#include "../generator/Aldous_Broder.h"
+#include "../generator/Backtracker.h"
+
+#define STEPS 100000
+
+int failures = 0;
+
+void expect_no_allocations(const char *name, size_t before) {
+    if (allocations != before) {
+        fprintf(stderr, "%s allocated %zu times\n", name, allocations - before);
+        failures++;
+    } else {
+        printf("%s allocated nothing\n", name);
+    }
+}
+
+/**
+ * Runs a generator once to size the context, then again on a new maze with
+ * the same context and counts what the second run allocates.
+ */
+void check_generator(const char *name, void (*maze_generator)(const Maze *, GeneratorContext *)) {
+    GeneratorContext *context = new_generator_context(0);
+    context->thread_count = 1;
+    Maze *first = new_maze(64, 48, false);
+    generate_maze_with_seed(first, context, maze_generator, 1);
+    delete_maze(first);
+
+    Maze *second = new_maze(64, 48, false);
+    get_cell_view(second);
+    size_t before = allocations;
+    generate_maze_with_seed(second, context, maze_generator, 2);
+    expect_no_allocations(name, before);
+    delete_maze(second);
+    delete_generator_context(context);
+}
+
+int main() {
+    Maze *maze = new_maze(64, 48, false);
+    Cell *cells = get_cell_view(maze);
+    Random random;
+    seed_random(&random, 1);
+
+    size_t before = allocations;
+    Cell *cell = &cells[index_at(maze, 0, 0)];
+    for (int step = 0; step < STEPS; step++) {
+        Cell *neighbours[DIRECTION_COUNT];
+        get_neighbouring_cells(maze, cell, neighbours);
+        get_neighbour_mask(maze, cell_index(cell));
+        random_unlinked_cell(maze, cell, &random);
+        cell = random_neighbour_cell(maze, cell, &random);
+    }
+    expect_no_allocations("neighbour lookups", before);
+    delete_maze(maze);
+
+    check_generator("hunt and kill", generate_hunt_and_kill_maze);
+    check_generator("aldous broder", generate_aldous_broder_maze);
+    check_generator("backtracker", generate_backtracker_maze);
+    return failures == 0 ? 0 : EXIT_FAILURE;
+}
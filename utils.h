@@ -4,187 +4,371 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include "Maze.h"
+#include "Random.h"
 
-#define HALF_RAND_MAX (RAND_MAX /2)
-
-bool coin_flip() {
-    return rand() <= HALF_RAND_MAX;
+/**
+ * @param bits The bits to look at, must not be 0
+ * @return The position of the lowest set bit
+ */
+int count_trailing_zeros(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bits);
+#else
+    int count = 0;
+    while ((bits & 1u) == 0) {
+        bits >>= 1u;
+        count++;
+    }
+    return count;
+#endif
 }
 
-int random_direction() {
-    return rand() % DIRECTION_COUNT;
+bool coin_flip(Random *random) {
+    return random_bool(random);
 }
 
-Cell *random_linked_cell(Cell *cell) {
-    if (cell == NULL || cell->neighbour_count <= 0) return NULL;
-    int neighbour_count = cell->neighbour_count;
+int random_direction(Random *random) {
+    return (int) (next_random(random) >> 62u);
+}
 
-    // Check to ensure there are valid neighbours
-    int null_count = 0;
-    for (int i = 0; i < neighbour_count; i++) {
-        if (cell->neighbours[i] == NULL) null_count++;
-        else break;
-    }
-    if (null_count >= neighbour_count) return NULL;
+// the directions in each 4 bit mask, lowest first
+static const signed char MASK_DIRECTIONS[1u << DIRECTION_COUNT][DIRECTION_COUNT] = {
+        {-1, -1, -1, -1},
+        {0, -1, -1, -1},
+        {1, -1, -1, -1},
+        {0, 1, -1, -1},
+        {2, -1, -1, -1},
+        {0, 2, -1, -1},
+        {1, 2, -1, -1},
+        {0, 1, 2, -1},
+        {3, -1, -1, -1},
+        {0, 3, -1, -1},
+        {1, 3, -1, -1},
+        {0, 1, 3, -1},
+        {2, 3, -1, -1},
+        {0, 2, 3, -1},
+        {1, 2, 3, -1},
+        {0, 1, 2, 3}
+};
 
-    int pos;
-    Cell *linked = NULL;
-    while (linked == NULL) {
-        pos = rand() % neighbour_count;
-        linked = cell->neighbours[pos];
-    }
-    return linked;
+/**
+ * Pick a random direction out of a mask of DIRECTION_BIT flags.
+ *
+ * This takes a single random draw however many directions are in the mask.
+ * @param mask The directions to pick from
+ * @param random The random state to pick with
+ * @return The direction picked or -1 if the mask was empty
+ */
+int random_direction_in(unsigned int mask, Random *random) {
+    mask &= OPEN_WALLS_MASK;
+    const unsigned int count = (mask & 1u) + ((mask >> 1u) & 1u) + ((mask >> 2u) & 1u) + (mask >> 3u);
+    if (count == 0) return -1;
+    return MASK_DIRECTIONS[mask][random_below(random, count)];
 }
 
-Cell *random_unlinked_cell(Maze *maze, Cell *cell) {
+Cell *random_linked_cell(Cell *cell, Random *random) {
     if (cell == NULL) return NULL;
+    int dir = random_direction_in(get_open_walls(cell->maze, cell_index(cell)), random);
+    if (dir < 0) return NULL;
+    return get_cell_adjacent(cell->maze, cell, dir);
+}
 
-    // create an array of all the possible neighbours
-    int neighbour_count = 0;
-    Cell **possible = get_all_neighbouring_cells(maze, cell, &neighbour_count);
-
-    // Ensure this cell has neighbours
-    int null_count = 0;
-    for (int i = 0; i < neighbour_count; i++) {
-        Cell *other = possible[i];
-        if (other == NULL) {
-            null_count++;
-        } else {
-            // NULL out any connected
-            int dir = neighbour_pos(cell, other);
-            if (dir != -1 && cell->neighbours[dir] == other) {
-                possible[i] = NULL;
-                null_count++;
-            }
-        }
+Cell *random_unlinked_cell(Maze *maze, Cell *cell, Random *random) {
+    if (maze == NULL || cell == NULL) return NULL;
+    size_t index = cell_index(cell);
+    unsigned int unlinked = get_neighbour_mask(maze, index) & ~get_open_walls(maze, index);
+    int dir = random_direction_in(unlinked, random);
+    if (dir < 0) return NULL;
+    return get_cell_adjacent(maze, cell, dir);
+}
+
+Cell *random_neighbour_cell(Maze *maze, Cell *cell, Random *random) {
+    if (maze == NULL || cell == NULL) return NULL;
+    int dir = random_direction_in(get_neighbour_mask(maze, cell_index(cell)), random);
+    if (dir < 0) return NULL;
+    return get_cell_adjacent(maze, cell, dir);
+}
+
+/**
+ * Pick a random index in the grid that has a cell in the maze.
+ *
+ * When no cells are missing a random position is used directly. Otherwise
+ * this picks from the live cell list, so takes the same time however many
+ * cells have been removed from the maze.
+ * @param maze The maze
+ * @param random The random state to pick with
+ * @return The grid index of a random cell
+ */
+size_t random_index(const Maze *maze, Random *random) {
+    if (maze->cell_count == 0) {
+        fprintf(stderr, "No cells in maze to pick from");
+        exit(EXIT_FAILURE);
     }
-    if (null_count >= neighbour_count) {
-        free(possible);
-        return NULL;
+    const size_t width = (size_t) maze->width;
+    if (maze->cell_count == width * (size_t) maze->height) {
+        // the same cell the live cell list would give, without building it
+        size_t position = random_below(random, maze->cell_count);
+        return index_at(maze, (int) (position % width), (int) (position / width));
     }
+    return get_live_cells(maze)[random_below(random, maze->cell_count)];
+}
 
-    Cell *unlinked = NULL;
-    while (unlinked == NULL) {
-        int dir = rand() % neighbour_count;
-        unlinked = possible[dir];
-    }
+Cell *random_cell(const Maze *maze, Random *random) {
+    if (maze == NULL || maze->cell_count == 0) return NULL;
+    size_t index = random_index(maze, random);
+    return cell_at(maze, index_x(maze, index), index_y(maze, index));
+}
 
-    free(possible);
-    return unlinked;
+/**
+ * A growable array of cells, held by grid index.
+ *
+ * Pushing and popping the end, picking a random entry and removing any entry
+ * are all constant time. Removing swaps the last entry into the gap so the
+ * order is not kept. Clearing keeps the storage so the same array can be
+ * reused for every generation without allocating again. CellList keeps the
+ * older list functions on top of it.
+ */
+typedef struct {
+    size_t *indexes;
+    size_t count;
+    size_t capacity;
+} CellArray;
+
+CellArray *new_cell_array(size_t capacity) {
+    CellArray *array = malloc(sizeof(CellArray));
+    if (array == NULL) {
+        fprintf(stderr, "Unable to allocate cell array");
+        exit(EXIT_FAILURE);
+    }
+    array->indexes = NULL;
+    array->count = 0;
+    array->capacity = 0;
+    if (capacity > 0) {
+        array->indexes = malloc(checked_size_multiply(capacity, sizeof(size_t)));
+        if (array->indexes == NULL) {
+            fprintf(stderr, "Unable to allocate cell array of size %zu", capacity);
+            exit(EXIT_FAILURE);
+        }
+        array->capacity = capacity;
+    }
+    return array;
 }
 
-Cell *random_neighbour_cell(Maze *maze, Cell *cell) {
-    if (maze == NULL || cell == NULL) return NULL;
+void delete_cell_array(CellArray *array) {
+    if (array == NULL) return;
+    free(array->indexes);
+    free(array);
+}
 
-    // create an array of all the possible neighbours
-    int neighbour_count = 0;
-    Cell **possible = get_all_neighbouring_cells(maze, cell, &neighbour_count);
+void clear_cell_array(CellArray *array) {
+    array->count = 0;
+}
 
-    // Ensure this cell has neighbours
-    int null_count = 0;
-    for (int i = 0; i < neighbour_count; i++) {
-        if (possible[i] == NULL) null_count++;
-        else break;
-    }
-    if (null_count >= neighbour_count) {
-        free(possible);
-        return NULL;
+/**
+ * Add a cell to the end of the array, growing it if needed.
+ * @param array The array
+ * @param index The grid index of the cell
+ */
+void push_to_cell_array(CellArray *array, size_t index) {
+    if (array->count == array->capacity) {
+        size_t capacity = array->capacity < 16 ? 16 : checked_size_multiply(array->capacity, 2);
+        size_t *grown = realloc(array->indexes, checked_size_multiply(capacity, sizeof(size_t)));
+        if (grown == NULL) {
+            fprintf(stderr, "Unable to grow cell array to size %zu", capacity);
+            exit(EXIT_FAILURE);
+        }
+        array->indexes = grown;
+        array->capacity = capacity;
     }
+    array->indexes[array->count++] = index;
+}
 
-    int dir;
-    Cell *neighbour = NULL;
-    while (neighbour == NULL) {
-        dir = rand() % neighbour_count;
-        neighbour = possible[dir];
-    }
-    free(possible);
-    return neighbour;
+/**
+ * Remove the last cell from the array.
+ * @param array The array, must not be empty
+ * @return The grid index of the cell removed
+ */
+size_t pop_from_cell_array(CellArray *array) {
+    return array->indexes[--array->count];
 }
 
-Cell *random_cell(const Maze *maze) {
-    if (maze == NULL) return NULL;
-    Cell *cell = NULL;
-    while (cell == NULL) {
-        int x = rand() % maze->width;
-        int y = rand() % maze->height;
-        cell = cell_at(maze, x, y);
-    }
-    return cell;
+/**
+ * Remove the cell at a position in the array, moving the last cell into its
+ * place.
+ * @param array The array
+ * @param position The position to remove, must be less than count
+ * @return The grid index of the cell removed
+ */
+size_t remove_from_cell_array(CellArray *array, size_t position) {
+    size_t index = array->indexes[position];
+    array->indexes[position] = array->indexes[--array->count];
+    return index;
 }
 
 /**
- * A simple doubly linked list type for Cells
+ * Pick a random cell from the array, leaving it in place.
+ * @param array The array, must not be empty
+ * @param random The random state to pick with
+ * @return The grid index of the cell picked
  */
+size_t pick_from_cell_array(const CellArray *array, Random *random) {
+    return array->indexes[random_below(random, array->count)];
+}
+
+/**
+ * Remove a random cell from the array.
+ * @param array The array, must not be empty
+ * @param random The random state to pick with
+ * @return The grid index of the cell removed
+ */
+size_t take_from_cell_array(CellArray *array, Random *random) {
+    return remove_from_cell_array(array, random_below(random, array->count));
+}
+
+/**
+ * A list of Cells from one maze, kept in the order they were added.
+ *
+ * The cells are held by grid index in a CellArray, so adding, taking the
+ * last cell, the length and picking a random cell are all constant time and
+ * there is no allocation per cell. NULL cells are never added.
+ *
+ * A list is handled through its CellListEntry values, any entry of a list can
+ * be passed where the list is wanted. An entry stands for a position in the
+ * list rather than a cell, so deleting a cell from the middle moves the cells
+ * after it down one entry. Entries are made in blocks the first time their
+ * position is asked for and are not moved or freed until the list is deleted.
+ */
+typedef struct CellList CellList;
+
 typedef struct CellListEntry {
-    Cell *cell;
-    struct CellListEntry *previous;
-    struct CellListEntry *next;
+    CellList *list;
+    size_t position;
 } CellListEntry;
 
+#define CELL_LIST_ENTRY_BLOCK 64
+
+struct CellList {
+    const Maze *maze;
+    CellArray *cells;
+    CellListEntry **entry_blocks;
+    size_t block_count;
+};
+
+/**
+ * @param list The list
+ * @param position The position in the list
+ * @return The entry for that position, made if this is the first time it is
+ * asked for
+ */
+CellListEntry *cell_list_entry_at(CellList *list, size_t position) {
+    size_t block = position / CELL_LIST_ENTRY_BLOCK;
+    if (block >= list->block_count) {
+        CellListEntry **blocks = realloc(
+                list->entry_blocks, checked_size_multiply(block + 1, sizeof(CellListEntry *))
+        );
+        if (blocks == NULL) {
+            fprintf(stderr, "Unable to grow cell list entries to %zu blocks", block + 1);
+            exit(EXIT_FAILURE);
+        }
+        list->entry_blocks = blocks;
+        for (size_t b = list->block_count; b <= block; b++) {
+            CellListEntry *entries = malloc(sizeof(CellListEntry) * CELL_LIST_ENTRY_BLOCK);
+            if (entries == NULL) {
+                fprintf(stderr, "Unable to allocate cell list entries");
+                exit(EXIT_FAILURE);
+            }
+            for (size_t i = 0; i < CELL_LIST_ENTRY_BLOCK; i++) {
+                entries[i].list = list;
+                entries[i].position = b * CELL_LIST_ENTRY_BLOCK + i;
+            }
+            blocks[b] = entries;
+        }
+        list->block_count = block + 1;
+    }
+    return &list->entry_blocks[block][position % CELL_LIST_ENTRY_BLOCK];
+}
+
+/**
+ * @param list The list
+ * @param position The position in the list
+ * @return The cell at that position, NULL if it has since been removed from
+ * the maze
+ */
+Cell *cell_list_at(const CellList *list, size_t position) {
+    size_t index = list->cells->indexes[position];
+    return cell_at(list->maze, index_x(list->maze, index), index_y(list->maze, index));
+}
+
 /**
- * Create a new Cell linked list using the given start cell.
+ * @param entry The entry
+ * @return The cell at the position of entry or NULL if the list does not
+ * reach that far
+ */
+Cell *cell_list_entry_cell(const CellListEntry *entry) {
+    if (entry == NULL || entry->position >= entry->list->cells->count) return NULL;
+    return cell_list_at(entry->list, entry->position);
+}
+
+/**
+ * Create a new Cell list using the given start cell.
  *
- * @param start The starting Cell, can be NULL
- * @return A pointer to a new CellListEntry
+ * @param start The starting Cell, can be NULL for an empty list
+ * @return A pointer to the first CellListEntry of the new list
  */
 CellListEntry *new_cell_list_entry(const Cell *start) {
-    CellListEntry *list = malloc(sizeof(CellListEntry));
+    CellList *list = malloc(sizeof(CellList));
     if (list == NULL) {
-        fprintf(stderr, "Unable to allocate cell list entry");
+        fprintf(stderr, "Unable to allocate cell list");
         exit(EXIT_FAILURE);
     }
-    list->cell = (Cell *) start;
-    list->previous = NULL;
-    list->next = NULL;
-    return list;
+    list->maze = NULL;
+    list->cells = new_cell_array(0);
+    list->entry_blocks = NULL;
+    list->block_count = 0;
+    if (start != NULL) {
+        list->maze = start->maze;
+        push_to_cell_array(list->cells, cell_index(start));
+    }
+    return cell_list_entry_at(list, 0);
 }
 
 /**
  * Get the last CellListEntry in a given list.
  *
- * @param start The CellListEntry to start from
- * @return A pointer to the last CellListEntry in a given list.
- * Can be the same as the starting entry or NULL if the start was NULL.
+ * @param start Any entry in the list
+ * @return A pointer to the last CellListEntry in the list or NULL if start
+ * was NULL or the list is empty
  */
 CellListEntry *peek_last_cell_list(const CellListEntry *start) {
-    if (start == NULL) return NULL;
-    CellListEntry *current = (CellListEntry *) start;
-    while (current->next != NULL) {
-        current = current->next;
-    }
-    return current;
+    if (start == NULL || start->list->cells->count == 0) return NULL;
+    return cell_list_entry_at(start->list, start->list->cells->count - 1);
 }
 
 /**
  * Get the first CellListEntry in a given list
  *
- * @param entry The entry to start searching from
- * @return A pointer to the first CellListEntry in a given list.
- * Can be the same as the entry given, or NULL if entry was NULL.
+ * @param entry Any entry in the list
+ * @return A pointer to the first CellListEntry in the list or NULL if entry
+ * was NULL
  */
 CellListEntry *peek_first_cell_list(CellListEntry *entry) {
     if (entry == NULL) return NULL;
-    CellListEntry *current = entry;
-    while (current->previous != NULL) {
-        current = current->previous;
-    }
-    return current;
+    return cell_list_entry_at(entry->list, 0);
 }
 
 /**
- * Push a given cell to the linked list.
+ * Push a given cell to the end of the list.
  *
- * @param start The start of the linked list
- * @param cell The cell to add to the end
- * @return The new CellListEntry or NULL if start was NULL
+ * @param start Any entry in the list
+ * @param cell The cell to add, must be from the same maze as the rest
+ * @return The new CellListEntry or NULL if start or cell was NULL
  */
 CellListEntry *push_to_cell_list(CellListEntry *start, Cell *cell) {
-    if (start == NULL) return NULL;
-    CellListEntry *last = peek_last_cell_list(start);
-    CellListEntry *next = new_cell_list_entry(cell);
-    next->previous = last;
-    last->next = next;
-    return next;
+    if (start == NULL || cell == NULL) return NULL;
+    CellList *list = start->list;
+    if (list->maze == NULL) list->maze = cell->maze;
+    push_to_cell_array(list->cells, cell_index(cell));
+    return cell_list_entry_at(list, list->cells->count - 1);
 }
 
 enum CellListDeleteResult {
@@ -193,52 +377,60 @@ enum CellListDeleteResult {
 };
 
 /**
- * Removes and deletes a CellListEntry from the list it is part of
+ * Delete an entire Cell list
+ * @param start Any entry in the list
+ */
+void delete_cell_list(CellListEntry *start) {
+    if (start == NULL) return;
+    CellList *list = start->list;
+    for (size_t b = 0; b < list->block_count; b++) {
+        free(list->entry_blocks[b]);
+    }
+    free(list->entry_blocks);
+    delete_cell_array(list->cells);
+    free(list);
+}
+
+/**
+ * Removes the cell at entry from the list it is part of, keeping the order of
+ * the rest.
  *
+ * Everything after it moves down so this is not constant time, use
+ * CellArray directly where the order does not matter.
  * @param entry The entry to delete
- * @return 0 if the entry was deleted, 1 if the whole list was deleted
+ * @return 0 if the entry was deleted, 1 if the list is now empty and has been
+ * deleted along with it
  */
 int delete_from_cell_list(CellListEntry *entry) {
     if (entry == NULL) return LIST_DELETED;
-
-    // Both of these can be NULL
-    CellListEntry *previous = entry->previous;
-    CellListEntry *next = entry->next;
-
-    // return NULL if the whole list is gone
-    if (next == NULL && previous == NULL) {
-        free(entry);
-        entry = NULL;
-        return LIST_DELETED;
+    CellArray *cells = entry->list->cells;
+    size_t position = entry->position;
+    if (position < cells->count) {
+        memmove(cells->indexes + position, cells->indexes + position + 1,
+                (cells->count - position - 1) * sizeof(size_t));
+        cells->count--;
     }
-
-    // Connect the other members of the list so connections are not lost
-    if (previous != NULL) {
-        previous->next = next;
-    }
-    if (next != NULL) {
-        next->previous = previous;
+    if (cells->count == 0) {
+        delete_cell_list(entry);
+        return LIST_DELETED;
     }
-    free(entry);
-    entry = NULL;
-
     return ENTRY_DELETED;
 }
 
 /**
- * Deletes the last added CellListEntry from a given list and returns the Cell
- * it referenced.
- * @param list The linked list to pop from
- * @return The last Cell referenced in the list whose entry has now been deleted.
- * Can be NULL if the list was NULL or the CellListEntry was pointing at a NULL
- * Cell.
+ * Deletes the last added cell from a given list and returns it.
+ *
+ * The last cell is always dropped, even when it has been removed from the
+ * maze since it was added and NULL is returned for it.
+ * @param list Any entry in the list to pop from
+ * @return The last Cell in the list, NULL if the list was NULL or empty or
+ * the cell is no longer in the maze
  */
 Cell *pop_last_from_cell_list(CellListEntry *list) {
-    if (list == NULL) return NULL;
-    CellListEntry *last = peek_last_cell_list(list);
-    Cell *cell = last->cell;
-    delete_from_cell_list(last);
-    return cell;
+    if (list == NULL || list->list->cells->count == 0) return NULL;
+    size_t index = pop_from_cell_array(list->list->cells);
+    const Maze *maze = list->list->maze;
+    return cell_at(maze, index_x(maze, index), index_y(maze, index));
 }
 
 /**
@@ -248,66 +440,32 @@ Cell *pop_last_from_cell_list(CellListEntry *list) {
  */
 void delete_all_after(CellListEntry const *entry) {
     if (entry == NULL) return;
-    CellListEntry *last = peek_last_cell_list(entry);
-    if (last == entry) return;
-
-    CellListEntry *current = last;
-    CellListEntry *previous = NULL;
-    do {
-        previous = current->previous;
-        delete_from_cell_list(current);
-        current = previous;
-    } while (current != NULL && current != entry);
-}
-
-/**
- * Delete an entire Cell linked list
- * @param start The start of the linked list
- */
-void delete_cell_list(CellListEntry *start) {
-    CellListEntry *current = start;
-    while (current != NULL) {
-        CellListEntry *to_delete = current;
-        current = current->next;
-        free(to_delete);
-        to_delete = NULL;
+    CellArray *cells = entry->list->cells;
+    if (entry->position + 1 < cells->count) {
+        cells->count = entry->position + 1;
     }
 }
 
 /**
- * Get the length of a Cell linked list
+ * Get the length of a Cell list
  *
- * @param start The starting entry
- * @return The length of the linked list
+ * @param start Any entry in the list
+ * @return The number of cells in the list
  */
 int length_of_cell_list(CellListEntry const *start) {
     if (start == NULL) return 0;
-    int count = 1;
-    CellListEntry *current = (CellListEntry *) start;
-    while (current->next != NULL) {
-        current = current->next;
-        count++;
-    }
-    return count;
+    return (int) start->list->cells->count;
 }
 
 /**
- * Pick a random Cell from the given Cell linked list
- * @param start The start of the linked list
- * @return A random cell from the linked list.
- * This can be NULL if start was NULL or the linked list contains NULL entries
+ * Pick a random Cell from the given Cell list
+ * @param start Any entry in the list
+ * @param random The random state to pick with
+ * @return A random cell from the list or NULL if it is empty
  */
-Cell *pick_from_cell_list(CellListEntry const *start) {
-    if (start == NULL) return NULL;
-    int count = length_of_cell_list(start);
-    int pos_to_return = rand() % count;
-    int pos = 0;
-    CellListEntry *current = (CellListEntry *) start;
-    while (pos < pos_to_return && current->next != NULL) {
-        current = current->next;
-        pos++;
-    }
-    return current->cell;
+Cell *pick_from_cell_list(CellListEntry const *start, Random *random) {
+    if (length_of_cell_list(start) == 0) return NULL;
+    return cell_list_at(start->list, random_below(random, start->list->cells->count));
 }
 
 Cell **cell_list_to_array(CellListEntry const *start, int *size) {
@@ -317,18 +475,13 @@ Cell **cell_list_to_array(CellListEntry const *start, int *size) {
         *size = 0;
         return array;
     }
-    array = malloc(sizeof(Cell *) * count);
+    array = malloc(checked_size_multiply(sizeof(Cell *), (size_t) count));
     if (array == NULL) {
         fprintf(stderr, "Unable to allocate array for cell list");
         exit(EXIT_FAILURE);
     }
-    CellListEntry *current = (CellListEntry *) start;
-    array[0] = start->cell;
-    int pos = 1;
-    while (current->next != NULL) {
-        current = current->next;
-        array[pos] = current->cell;
-        pos++;
+    for (int i = 0; i < count; i++) {
+        array[i] = cell_list_at(start->list, (size_t) i);
     }
     *size = count;
     return array;
@@ -481,14 +634,14 @@ bool in_cell_tree(const CellTreeNode *root, const Cell *cell) {
     return false;
 }
 
-int total_cells_in_tree(const CellTreeNode *root) {
+size_t total_cells_in_tree(const CellTreeNode *root) {
     if (root == NULL) return 0;
     int child_count = root->child_count;
     if (child_count <= 0) return 1;
 
-    int count = 1;
+    size_t count = 1;
     for (int i = 0; i < child_count; i++) {
-        int inc = total_cells_in_tree(root->children[i]);
+        size_t inc = total_cells_in_tree(root->children[i]);
         count += inc;
     }
     return count;